@@ -0,0 +1,40 @@
+"use strict";
+var system = require('system'),
+    args = system.args,
+    jar = require('cookiejar').create(),
+    numCookies = args.length > 1 ? parseInt(args[1], 10) : 10000,
+    numDomains = args.length > 2 ? parseInt(args[2], 10) : 500,
+    numLookups = args.length > 3 ? parseInt(args[3], 10) : 10000,
+    expires = new Date().getTime() + 3600 * 1000,
+    start, i, found = 0;
+
+console.log('Usage: cookiebench.js [cookies] [domains] [lookups]');
+
+function domainName(i) {
+    return 'site' + (i % numDomains) + '.example.com';
+}
+
+start = Date.now();
+for (i = 0; i < numCookies; ++i) {
+    jar.addCookie({
+        'name':     'cookie' + i,
+        'value':    'value' + i,
+        'domain':   '.' + domainName(i),
+        'path':     (i % 3 === 0) ? '/' : '/path' + (i % 7),
+        'expires':  expires + i
+    });
+}
+console.log('Added ' + jar.cookies.length + ' cookies over ' + numDomains + ' domains in ' +
+    (Date.now() - start) + ' ms');
+
+start = Date.now();
+for (i = 0; i < numLookups; ++i) {
+    found += jar.cookiesToMap('http://www.' + domainName(i * 7) + '/path' + (i % 7) + '/page.html').length;
+}
+var elapsed = Date.now() - start;
+console.log(numLookups + ' lookups in ' + elapsed + ' ms (' +
+    (elapsed * 1000 / numLookups).toFixed(1) + ' us per lookup, ' +
+    (found / numLookups).toFixed(1) + ' cookies per lookup)');
+
+jar.close();
+phantom.exit();
@@ -0,0 +1,44 @@
+"use strict";
+var system = require('system'),
+    server = require('webserver').create(),
+    args = system.args,
+    options = {}, delay, port;
+
+if (args.length < 2) {
+    console.log('Usage: serverbench.js <portnumber> [delay-ms] [option=value...]');
+    console.log('Options: keepAlive, numThreads, maxRequestSize, backlog, keepAliveTimeout');
+    phantom.exit(1);
+}
+
+port = args[1];
+delay = args.length > 2 ? parseInt(args[2], 10) : 0;
+args.slice(3).forEach(function (arg) {
+    var pair = arg.split('=');
+    options[pair[0]] = pair[0] === 'keepAlive' ? pair[1] === 'true' : parseInt(pair[1], 10);
+});
+
+var body = 'Hello from PhantomJS\n';
+
+function respond(response) {
+    response.statusCode = 200;
+    response.headers = {
+        'Content-Type': 'text/plain',
+        'Content-Length': body.length
+    };
+    response.write(body);
+    response.close();
+}
+
+if (server.listen(port, options, function (request, response) {
+    // The delay stands for the time spent rendering a page
+    if (delay > 0) {
+        setTimeout(function () { respond(response); }, delay);
+    } else {
+        respond(response);
+    }
+})) {
+    console.log('Web server running on port ' + port + ' with ' + JSON.stringify(options));
+} else {
+    console.log('Error: Could not create web server listening on port ' + port);
+    phantom.exit(1);
+}
@@ -48,10 +48,13 @@
 
 static const struct QCommandLineConfigEntry flags[] = {
     { QCommandLine::Option, '\0', "cookies-file", "Sets the file name to store the persistent cookies", QCommandLine::Optional },
+    { QCommandLine::Option, '\0', "cookies-file-format", "Format of new cookies files: 'ini' (default) or 'journal' (append-only, can be shared by several processes)", QCommandLine::Optional },
     { QCommandLine::Option, '\0', "config", "Specifies JSON-formatted configuration file", QCommandLine::Optional },
     { QCommandLine::Option, '\0', "debug", "Prints additional warning and debug message: 'true' or 'false' (default)", QCommandLine::Optional },
     { QCommandLine::Option, '\0', "disk-cache", "Enables disk cache: 'true' or 'false' (default)", QCommandLine::Optional },
     { QCommandLine::Option, '\0', "disk-cache-path", "Specifies the location for the disk cache", QCommandLine::Optional },
+    { QCommandLine::Option, '\0', "dns-cache-ttl", "Caches resolved HTTP hosts for the given number of seconds, '0' (default) leaves resolution to the system", QCommandLine::Optional },
+    { QCommandLine::Option, '\0', "host-resolver-rules", "Maps host names to other hosts, e.g. '--host-resolver-rules=\"MAP *.example.com 127.0.0.1:8080, EXCLUDE www.example.com\"'", QCommandLine::Optional },
     { QCommandLine::Option, '\0', "ignore-ssl-errors", "Ignores SSL errors (expired/self-signed certificate errors): 'true' or 'false' (default)", QCommandLine::Optional },
     { QCommandLine::Option, '\0', "load-images", "Loads all inlined images: 'true' (default) or 'false'", QCommandLine::Optional },
     { QCommandLine::Option, '\0', "local-url-access", "Allows use of 'file:///' URLs: 'true' (default) or 'false'", QCommandLine::Optional },
@@ -205,6 +208,16 @@ void Config::setCookiesFile(const QString& value)
     m_cookiesFile = value;
 }
 
+QString Config::cookiesFileFormat() const
+{
+    return m_cookiesFileFormat;
+}
+
+void Config::setCookiesFileFormat(const QString& value)
+{
+    m_cookiesFileFormat = value;
+}
+
 QString Config::offlineStoragePath() const
 {
     return m_offlineStoragePath;
@@ -279,6 +292,26 @@ void Config::setDiskCachePath(const QString& value)
     m_diskCachePath = dir.absolutePath();
 }
 
+QString Config::hostResolverRules() const
+{
+    return m_hostResolverRules;
+}
+
+void Config::setHostResolverRules(const QString& value)
+{
+    m_hostResolverRules = value;
+}
+
+int Config::dnsCacheTtl() const
+{
+    return m_dnsCacheTtl;
+}
+
+void Config::setDnsCacheTtl(int seconds)
+{
+    m_dnsCacheTtl = seconds;
+}
+
 bool Config::ignoreSslErrors() const
 {
     return m_ignoreSslErrors;
@@ -580,6 +613,7 @@ void Config::resetToDefaults()
 {
     m_autoLoadImages = true;
     m_cookiesFile = QString();
+    m_cookiesFileFormat = "ini";
     m_offlineStoragePath = QString();
     m_offlineStorageDefaultQuota = -1;
     m_localStoragePath = QString();
@@ -587,6 +621,8 @@ void Config::resetToDefaults()
     m_diskCacheEnabled = false;
     m_maxDiskCacheSize = -1;
     m_diskCachePath = QString();
+    m_hostResolverRules = QString();
+    m_dnsCacheTtl = 0;
     m_ignoreSslErrors = false;
     m_localUrlAccessEnabled = true;
     m_localToRemoteUrlAccessEnabled = false;
@@ -716,6 +752,10 @@ void Config::handleOption(const QString& option, const QVariant& value)
         setCookiesFile(value.toString());
     }
 
+    if (option == "cookies-file-format") {
+        setCookiesFileFormat(value.toString());
+    }
+
     if (option == "config") {
         loadJsonFile(value.toString());
     }
@@ -732,6 +772,14 @@ void Config::handleOption(const QString& option, const QVariant& value)
         setDiskCachePath(value.toString());
     }
 
+    if (option == "dns-cache-ttl") {
+        setDnsCacheTtl(value.toInt());
+    }
+
+    if (option == "host-resolver-rules") {
+        setHostResolverRules(value.toString());
+    }
+
     if (option == "ignore-ssl-errors") {
         setIgnoreSslErrors(boolValue);
     }
@@ -42,9 +42,12 @@ class Config: public QObject
 {
     Q_OBJECT
     Q_PROPERTY(QString cookiesFile READ cookiesFile WRITE setCookiesFile)
+    Q_PROPERTY(QString cookiesFileFormat READ cookiesFileFormat WRITE setCookiesFileFormat)
     Q_PROPERTY(bool diskCacheEnabled READ diskCacheEnabled WRITE setDiskCacheEnabled)
     Q_PROPERTY(int maxDiskCacheSize READ maxDiskCacheSize WRITE setMaxDiskCacheSize)
     Q_PROPERTY(QString diskCachePath READ diskCachePath WRITE setDiskCachePath)
+    Q_PROPERTY(QString hostResolverRules READ hostResolverRules WRITE setHostResolverRules)
+    Q_PROPERTY(int dnsCacheTtl READ dnsCacheTtl WRITE setDnsCacheTtl)
     Q_PROPERTY(bool ignoreSslErrors READ ignoreSslErrors WRITE setIgnoreSslErrors)
     Q_PROPERTY(bool localUrlAccessEnabled READ localUrlAccessEnabled WRITE setLocalUrlAccessEnabled)
     Q_PROPERTY(bool localToRemoteUrlAccessEnabled READ localToRemoteUrlAccessEnabled WRITE setLocalToRemoteUrlAccessEnabled)
@@ -87,6 +90,9 @@ public:
     QString cookiesFile() const;
     void setCookiesFile(const QString& cookiesFile);
 
+    QString cookiesFileFormat() const;
+    void setCookiesFileFormat(const QString& format);
+
     QString offlineStoragePath() const;
     void setOfflineStoragePath(const QString& value);
 
@@ -108,6 +114,12 @@ public:
     QString diskCachePath() const;
     void setDiskCachePath(const QString& value);
 
+    QString hostResolverRules() const;
+    void setHostResolverRules(const QString& value);
+
+    int dnsCacheTtl() const;
+    void setDnsCacheTtl(int seconds);
+
     bool ignoreSslErrors() const;
     void setIgnoreSslErrors(const bool value);
 
@@ -224,6 +236,7 @@ private:
     QCommandLine* m_cmdLine;
     bool m_autoLoadImages;
     QString m_cookiesFile;
+    QString m_cookiesFileFormat;
     QString m_offlineStoragePath;
     int m_offlineStorageDefaultQuota;
     QString m_localStoragePath;
@@ -231,6 +244,8 @@ private:
     bool m_diskCacheEnabled;
     int m_maxDiskCacheSize;
     QString m_diskCachePath;
+    QString m_hostResolverRules;
+    int m_dnsCacheTtl;
     bool m_ignoreSslErrors;
     bool m_localUrlAccessEnabled;
     bool m_localToRemoteUrlAccessEnabled;
@@ -31,14 +31,23 @@
 #include "phantom.h"
 #include "config.h"
 #include "cookiejar.h"
+#include "cookiejournal.h"
 
+#include <QCoreApplication>
 #include <QDateTime>
 #include <QDataStream>
+#include <QFile>
+#include <QFileSystemWatcher>
 #include <QSettings>
 #include <QTimer>
 
 #define COOKIE_JAR_VERSION      1
 
+// Changes are written once the jar has been quiet for this long...
+#define DEFAULT_SAVE_DELAY      500
+// ...but a stream of changes never postpones the write by more than this factor
+#define MAX_SAVE_DELAY_FACTOR   10
+
 // Operators needed for Cookie Serialization
 QT_BEGIN_NAMESPACE
 QDataStream& operator<<(QDataStream& stream, const QList<QNetworkCookie>& list)
@@ -83,13 +92,34 @@ QDataStream& operator>>(QDataStream& stream, QList<QNetworkCookie>& list)
 QT_END_NAMESPACE
 
 // public:
-CookieJar::CookieJar(QString cookiesFile, QObject* parent)
+CookieJar::CookieJar(QString cookiesFile, StorageFormat format, QObject* parent)
     : QNetworkCookieJar(parent)
+    , m_cookieStorage(0)
+    , m_journal(0)
+    , m_journalWatcher(0)
     , m_enabled(true)
+    , m_dirty(false)
+    , m_saveDelay(DEFAULT_SAVE_DELAY)
+    , m_saveTimer(new QTimer(this))
+    , m_maxSaveTimer(new QTimer(this))
 {
+    // Cookie changes are coalesced and written behind: see "scheduleSave()"
+    m_saveTimer->setSingleShot(true);
+    m_maxSaveTimer->setSingleShot(true);
+    connect(m_saveTimer, SIGNAL(timeout()), this, SLOT(flush()));
+    connect(m_maxSaveTimer, SIGNAL(timeout()), this, SLOT(flush()));
+    connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()), this, SLOT(flush()));
+
     if (cookiesFile == "") {
-        m_cookieStorage = 0;
         qDebug() << "CookieJar - Created but will not store cookies (use option '--cookies-file=<filename>' to enable persistent cookie storage)";
+    } else if (format == JournalFormat || CookieJournal::isJournal(cookiesFile)) {
+        m_journal = new CookieJournal(cookiesFile);
+        load();
+        // Other processes may share this journal: pick up their changes as they are written
+        m_journalWatcher = new QFileSystemWatcher(this);
+        connect(m_journalWatcher, SIGNAL(fileChanged(QString)), this, SLOT(refresh()));
+        watchJournal();
+        qDebug() << "CookieJar - Created and will journal cookies in:" << cookiesFile;
     } else {
         m_cookieStorage = new QSettings(cookiesFile, QSettings::IniFormat, this);
         load();
@@ -100,9 +130,13 @@ CookieJar::CookieJar(QString cookiesFile, QObject* parent)
 // private:
 CookieJar::~CookieJar()
 {
-    // On destruction, before saving, clear all the session cookies
-    purgeSessionCookies();
-    save();
+    // On destruction, before saving, clear all the session cookies.
+    // A journal never holds session cookies: there is nothing to purge from it.
+    if (!m_journal && purgeSessionCookies()) {
+        m_dirty = true;
+    }
+    flush();
+    delete m_journal;
 }
 
 bool CookieJar::setCookiesFromUrl(const QList<QNetworkCookie>& cookieList, const QUrl& url)
@@ -110,7 +144,7 @@ bool CookieJar::setCookiesFromUrl(const QList<QNetworkCookie>& cookieList, const
     // Update cookies in memory
     if (isEnabled()) {
         QNetworkCookieJar::setCookiesFromUrl(cookieList, url);
-        save();
+        scheduleSave();
     }
     // No changes occurred
     return false;
@@ -119,12 +153,37 @@ bool CookieJar::setCookiesFromUrl(const QList<QNetworkCookie>& cookieList, const
 QList<QNetworkCookie> CookieJar::cookiesForUrl(const QUrl& url) const
 {
     if (isEnabled()) {
-        return QNetworkCookieJar::cookiesForUrl(url);
+        return m_store.forUrl(url);
     }
     // The CookieJar is disabled: don't return any cookie
     return QList<QNetworkCookie>();
 }
 
+bool CookieJar::insertCookie(const QNetworkCookie& cookie)
+{
+    // Setting an already expired cookie is how servers delete it
+    bool isDeletion = !cookie.isSessionCookie() && cookie.expirationDate() < QDateTime::currentDateTimeUtc();
+    if (isDeletion) {
+        storeRemove(cookie);
+        return false;
+    }
+    storeInsert(cookie);
+    return true;
+}
+
+bool CookieJar::updateCookie(const QNetworkCookie& cookie)
+{
+    if (storeRemove(cookie)) {
+        return insertCookie(cookie);
+    }
+    return false;
+}
+
+bool CookieJar::deleteCookie(const QNetworkCookie& cookie)
+{
+    return storeRemove(cookie);
+}
+
 bool CookieJar::addCookie(const QNetworkCookie& cookie, const QString& url)
 {
     if (isEnabled() && (!url.isEmpty() || !cookie.domain().isEmpty())) {
@@ -306,8 +365,6 @@ bool CookieJar::deleteCookie(const QString& name, const QString& url)
         // easy to understand. Surely this could be "shrinked", but it
         // would probably look uglier.
 
-        QList<QNetworkCookie> cookiesListAll;
-
         if (url.isEmpty()) {
             if (name.isEmpty()) {           //< Neither "name" or "url" provided
                 // This method has been used wrong:
@@ -315,27 +372,24 @@ bool CookieJar::deleteCookie(const QString& name, const QString& url)
                 clearCookies();
             } else {                        //< Only "name" provided
                 // Delete all cookies with the given name from the CookieJar
-                cookiesListAll = allCookies();
-                for (int i = cookiesListAll.length() - 1; i >= 0; --i) {
-                    if (cookiesListAll.at(i).name() == name) {
+                foreach(const QNetworkCookie & cookie, allCookies()) {
+                    if (cookie.name() == name) {
                         // Remove this cookie
-                        qDebug() << "CookieJar - Deleted" << cookiesListAll.at(i).toRawForm();
-                        cookiesListAll.removeAt(i);
+                        qDebug() << "CookieJar - Deleted" << cookie.toRawForm();
+                        storeRemove(cookie);
                         deleted = true;
                     }
                 }
             }
         } else {
-            // Delete cookie(s) from the ones visible to the given "url".
+            // Delete cookie(s) from the ones visible to the given "url",
+            // most specific path first.
             // Use the "name" to delete only the right one, otherwise all of them.
-            QList<QNetworkCookie> cookiesListUrl = cookies(url);
-            cookiesListAll = allCookies();
-            for (int i = cookiesListAll.length() - 1; i >= 0; --i) {
-                if (cookiesListUrl.contains(cookiesListAll.at(i)) &&            //< if it part of the set of cookies visible at URL
-                        (cookiesListAll.at(i).name() == name || name.isEmpty())) {  //< and if the name matches, or no name provided
+            foreach(const QNetworkCookie & cookie, cookies(url)) {
+                if (cookie.name() == name || name.isEmpty()) {
                     // Remove this cookie
-                    qDebug() << "CookieJar - Deleted" << cookiesListAll.at(i).toRawForm();
-                    cookiesListAll.removeAt(i);
+                    qDebug() << "CookieJar - Deleted" << cookie.toRawForm();
+                    storeRemove(cookie);
                     deleted = true;
 
                     if (!name.isEmpty()) {
@@ -346,8 +400,9 @@ bool CookieJar::deleteCookie(const QString& name, const QString& url)
             }
         }
 
-        // Put back the remaining cookies
-        setAllCookies(cookiesListAll);
+        if (deleted) {
+            scheduleSave();
+        }
     }
     return deleted;
 }
@@ -372,6 +427,7 @@ void CookieJar::clearCookies()
 {
     if (isEnabled()) {
         setAllCookies(QList<QNetworkCookie>());
+        scheduleSave();
     }
 }
 
@@ -390,37 +446,57 @@ bool CookieJar::isEnabled() const
     return m_enabled;
 }
 
+int CookieJar::saveDelay() const
+{
+    return m_saveDelay;
+}
+
+void CookieJar::setSaveDelay(int msecs)
+{
+    m_saveDelay = qMax(0, msecs);
+    if (m_saveDelay == 0) {
+        // Back to write-through: don't leave pending changes behind
+        flush();
+    }
+}
+
 void CookieJar::close()
 {
     deleteLater();
 }
 
-// private:
-bool CookieJar::purgeExpiredCookies()
+QObject* CookieJar::fork()
 {
-    QList<QNetworkCookie> cookiesList = allCookies();
+    CookieJar* clone = new CookieJar(QString(), IniFormat, Phantom::instance());
+    clone->m_store = m_store;
+    clone->m_enabled = m_enabled;
+    return clone;
+}
 
-    // If empty, there is nothing to purge
-    if (cookiesList.isEmpty()) {
-        return false;
-    }
+void CookieJar::flush()
+{
+    m_saveTimer->stop();
+    m_maxSaveTimer->stop();
 
-    // Check if any cookie has expired
-    int prePurgeCookiesCount = cookiesList.count();
-    QDateTime now = QDateTime::currentDateTime();
-    for (int i = cookiesList.count() - 1; i >= 0; --i) {
-        if (!cookiesList.at(i).isSessionCookie() && cookiesList.at(i).expirationDate() < now) {
-            qDebug() << "CookieJar - Purged (expired)" << cookiesList.at(i).toRawForm();
-            cookiesList.removeAt(i);
-        }
+    if (m_dirty) {
+        save();
     }
+}
 
-    // Set cookies and returns "true" if at least 1 cookie expired and has been removed
-    if (prePurgeCookiesCount != cookiesList.count()) {
-        setAllCookies(cookiesList);
-        return true;
+// private:
+bool CookieJar::purgeExpiredCookies()
+{
+    // Expired cookies are popped off the store's expiry heap: no need to look at the others
+    QList<QNetworkCookie> expiredCookies = m_store.takeExpired(QDateTime::currentMSecsSinceEpoch());
+
+#ifndef QT_NO_DEBUG_OUTPUT
+    foreach(QNetworkCookie cookie, expiredCookies) {
+        qDebug() << "CookieJar - Purged (expired)" << cookie.toRawForm();
     }
-    return false;
+#endif
+
+    // Returns "true" if at least 1 cookie expired and has been removed
+    return !expiredCookies.isEmpty();
 }
 
 bool CookieJar::purgeSessionCookies()
@@ -432,21 +508,18 @@ bool CookieJar::purgeSessionCookies()
         return false;
     }
 
-    // Check if any cookie has expired
-    int prePurgeCookiesCount = cookiesList.count();
-    for (int i = cookiesList.count() - 1; i >= 0; --i) {
-        if (cookiesList.at(i).isSessionCookie()) {
-            qDebug() << "CookieJar - Purged (session)" << cookiesList.at(i).toRawForm();
-            cookiesList.removeAt(i);
+    // Remove the session cookies one by one, so the journal (if any) only records those
+    bool purged = false;
+    foreach(const QNetworkCookie & cookie, cookiesList) {
+        if (cookie.isSessionCookie()) {
+            qDebug() << "CookieJar - Purged (session)" << cookie.toRawForm();
+            storeRemove(cookie);
+            purged = true;
         }
     }
 
-    // Set cookies and returns "true" if at least 1 session cookie was found and removed
-    if (prePurgeCookiesCount != cookiesList.count()) {
-        setAllCookies(cookiesList);
-        return true;
-    }
-    return false;
+    // Returns "true" if at least 1 session cookie was found and removed
+    return purged;
 }
 
 void CookieJar::save()
@@ -461,13 +534,33 @@ void CookieJar::save()
         }
 #endif
 
-        // Store cookies
-        if (m_cookieStorage) {
+        // Store cookies.
+        // NOTE: "sync()" writes a temporary file and renames it over the
+        // previous one, so a crash mid-write never leaves a truncated jar.
+        if (m_journal) {
+            // Append what changed since the last save, unless it's time to compact
+            if (m_journal->needsCompaction(m_store.count())) {
+                m_journal->compact(m_store);
+            } else {
+                m_journal->append(m_store);
+            }
+            watchJournal();
+        } else if (m_cookieStorage) {
             m_cookieStorage->setValue(QLatin1String("cookies"), QVariant::fromValue<QList<QNetworkCookie> >(allCookies()));
+            m_cookieStorage->sync();
         }
+        m_dirty = false;
     }
 }
 
+void CookieJar::refresh()
+{
+    if (isEnabled() && m_journal->refresh(m_store)) {
+        qDebug() << "CookieJar - Reloaded changes from" << m_journal->path();
+    }
+    watchJournal();
+}
+
 void CookieJar::load()
 {
     if (isEnabled()) {
@@ -475,13 +568,22 @@ void CookieJar::load()
         qRegisterMetaTypeStreamOperators<QList<QNetworkCookie> >("QList<QNetworkCookie>");
 
         // Load all the cookies
-        if (m_cookieStorage) {
+        if (m_journal) {
+            if (!m_journal->replay(m_store)) {
+                // Still a jar saved in INI format: import it and switch it over to a journal
+                QSettings cookieStorage(m_journal->path(), QSettings::IniFormat);
+                foreach(const QNetworkCookie & cookie, qvariant_cast<QList<QNetworkCookie> >(cookieStorage.value(QLatin1String("cookies")))) {
+                    m_store.insert(cookie);
+                }
+                m_journal->compact(m_store);
+            }
+        } else if (m_cookieStorage) {
             setAllCookies(qvariant_cast<QList<QNetworkCookie> >(m_cookieStorage->value(QLatin1String("cookies"))));
         }
 
-        // If any cookie has expired since last execution, purge and save before going any further
+        // If any cookie has expired since last execution, purge and save it soon
         if (purgeExpiredCookies()) {
-            save();
+            scheduleSave();
         }
 
 #ifndef QT_NO_DEBUG_OUTPUT
@@ -492,14 +594,71 @@ void CookieJar::load()
     }
 }
 
+QList<QNetworkCookie> CookieJar::allCookies() const
+{
+    return m_store.all();
+}
+
+void CookieJar::setAllCookies(const QList<QNetworkCookie>& cookieList)
+{
+    m_store.clear();
+    if (m_journal) {
+        m_journal->recordClear();
+    }
+    foreach(const QNetworkCookie & cookie, cookieList) {
+        storeInsert(cookie);
+    }
+}
+
 bool CookieJar::contains(const QNetworkCookie& cookieToFind) const
 {
-    QList<QNetworkCookie> cookiesList = allCookies();
-    foreach(QNetworkCookie cookie, cookiesList) {
-        if (cookieToFind == cookie) {
-            return true;
-        }
+    return m_store.contains(cookieToFind);
+}
+
+void CookieJar::scheduleSave()
+{
+    // Nothing to write to
+    if (!m_cookieStorage && !m_journal) {
+        return;
     }
 
-    return false;
+    m_dirty = true;
+    if (m_saveDelay == 0) {
+        flush();
+        return;
+    }
+
+    // Restart the idle timer on every change, but never move the deadline
+    // set by the first unsaved change
+    m_saveTimer->start(m_saveDelay);
+    if (!m_maxSaveTimer->isActive()) {
+        m_maxSaveTimer->start(m_saveDelay * MAX_SAVE_DELAY_FACTOR);
+    }
+}
+
+void CookieJar::storeInsert(const QNetworkCookie& cookie)
+{
+    m_store.insert(cookie);
+    if (m_journal) {
+        m_journal->recordInsert(cookie);
+    }
+}
+
+bool CookieJar::storeRemove(const QNetworkCookie& cookie)
+{
+    if (!m_store.remove(cookie)) {
+        return false;
+    }
+    if (m_journal) {
+        m_journal->recordRemove(cookie);
+    }
+    return true;
+}
+
+void CookieJar::watchJournal()
+{
+    // Compacting renames a new file over the journal, which drops it from the watcher
+    if (m_journalWatcher && !m_journalWatcher->files().contains(m_journal->path()) && QFile::exists(m_journal->path())) {
+        m_journalWatcher->addPath(m_journal->path());
+    }
 }
@@ -37,19 +37,35 @@
 #include <QVariantList>
 #include <QVariantMap>
 
+#include "cookiestore.h"
+
+class CookieJournal;
+class QFileSystemWatcher;
+class QTimer;
+
 class CookieJar: public QNetworkCookieJar
 {
     Q_OBJECT
 
     Q_PROPERTY(QVariantList cookies READ cookiesToMap WRITE addCookiesFromMap)
+    Q_PROPERTY(int saveDelay READ saveDelay WRITE setSaveDelay)
 
 public:
-    CookieJar(QString cookiesFile, QObject* parent = NULL);
+    enum StorageFormat {
+        IniFormat,      ///< The whole jar, rewritten on every save
+        JournalFormat   ///< Append-only journal of changes, see CookieJournal
+    };
+
+    CookieJar(QString cookiesFile, StorageFormat format = IniFormat, QObject* parent = NULL);
     virtual ~CookieJar();
 
     bool setCookiesFromUrl(const QList<QNetworkCookie>& cookieList, const QUrl& url);
     QList<QNetworkCookie> cookiesForUrl(const QUrl& url) const;
 
+    bool insertCookie(const QNetworkCookie& cookie);
+    bool updateCookie(const QNetworkCookie& cookie);
+    bool deleteCookie(const QNetworkCookie& cookie);
+
     bool addCookie(const QNetworkCookie& cookie, const QString& url = QString());
     bool addCookies(const QList<QNetworkCookie>& cookiesList, const QString& url = QString());
 
@@ -57,13 +73,15 @@ public:
 
     QNetworkCookie cookie(const QString& name, const QString& url = QString()) const;
 
-    using QNetworkCookieJar::deleteCookie;
     bool deleteCookies(const QString& url = QString());
 
     void enable();
     void disable();
     bool isEnabled() const;
 
+    int saveDelay() const;
+    void setSaveDelay(int msecs);
+
 public slots:
     void addCookie(const QVariantMap& cookie);
     bool addCookieFromMap(const QVariantMap& cookie, const QString& url = QString());
@@ -73,19 +91,45 @@ public slots:
     bool deleteCookie(const QString& name, const QString& url = QString());
     void clearCookies();
     void close();
+    void flush();
+
+    /**
+     * Create a new, in-memory jar holding the same cookies as this one.
+     * The cookies are shared until either jar changes, so forking a large
+     * jar is cheap; changes to one jar are never seen by the other.
+     */
+    QObject* fork();
 
 private slots:
     bool purgeExpiredCookies();
     bool purgeSessionCookies();
     void save();
     void load();
+    void refresh();
+
+protected:
+    // Cookies live in "m_store": these hide the QNetworkCookieJar versions,
+    // whose flat list is left empty
+    QList<QNetworkCookie> allCookies() const;
+    void setAllCookies(const QList<QNetworkCookie>& cookieList);
 
 private:
     bool contains(const QNetworkCookie& cookie) const;
+    void storeInsert(const QNetworkCookie& cookie);
+    bool storeRemove(const QNetworkCookie& cookie);
+    void scheduleSave();
+    void watchJournal();
 
 private:
     QSettings* m_cookieStorage;
+    CookieJournal* m_journal;
+    QFileSystemWatcher* m_journalWatcher;
+    CookieStore m_store;
     bool m_enabled;
+    bool m_dirty;
+    int m_saveDelay;
+    QTimer* m_saveTimer;
+    QTimer* m_maxSaveTimer;
 };
 
 #endif // COOKIEJAR_H
@@ -0,0 +1,410 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "cookiejournal.h"
+#include "cookiestore.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+#include <QUuid>
+
+#define JOURNAL_MAGIC               0x504a434a      // "PJCJ"
+#define JOURNAL_VERSION             1
+
+// A journal is compacted once it holds this many times more records than live cookies...
+#define COMPACTION_FACTOR           4
+// ...and at least this many records
+#define COMPACTION_MIN_RECORDS      256
+
+// How long to wait for another process to release the journal (ms)
+#define LOCK_TIMEOUT                5000
+// A lock file older than this is left over by a crashed process (ms)
+#define LOCK_STALE_TIME             30000
+
+enum RecordType {
+    RecordInsert = 'I',
+    RecordRemove = 'R',
+    RecordClear = 'C'
+};
+
+static void writeHeader(QDataStream& out, const QByteArray& fileId)
+{
+    out.setVersion(QDataStream::Qt_5_5);
+    out << quint32(JOURNAL_MAGIC) << quint32(JOURNAL_VERSION) << fileId;
+}
+
+// Drop what the journal holds, keeping the session cookies of this process
+static void clearPersistentCookies(CookieStore& store)
+{
+    foreach(const QNetworkCookie & cookie, store.all()) {
+        if (!cookie.isSessionCookie()) {
+            store.remove(cookie);
+        }
+    }
+}
+
+CookieJournal::CookieJournal(const QString& path)
+    : m_path(path)
+    , m_lock(path + ".lock")
+    , m_offset(0)
+    , m_pendingRecords(0)
+    , m_records(0)
+    , m_damaged(false)
+{
+    m_lock.setStaleLockTime(LOCK_STALE_TIME);
+}
+
+QString CookieJournal::path() const
+{
+    return m_path;
+}
+
+bool CookieJournal::isJournal(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    in >> magic;
+    return in.status() == QDataStream::Ok && magic == JOURNAL_MAGIC;
+}
+
+bool CookieJournal::replay(CookieStore& store)
+{
+    const bool locked = lock();
+    bool isJournal = true;
+    readRecords(store, &isJournal);
+    if (locked) {
+        m_lock.unlock();
+    }
+    return isJournal;
+}
+
+bool CookieJournal::refresh(CookieStore& store)
+{
+    // The journal is also reported changed after our own writes: nothing to do then
+    if (isUpToDate()) {
+        return false;
+    }
+    if (!lock()) {
+        return false;
+    }
+
+    const bool changed = readRecords(store);
+    if (changed) {
+        reapplyPending(store);
+    }
+    if (m_damaged) {
+        writeSnapshot(store.all());
+    }
+
+    m_lock.unlock();
+    return changed;
+}
+
+void CookieJournal::recordInsert(const QNetworkCookie& cookie)
+{
+    if (cookie.isSessionCookie()) {
+        // Not journaled, but it replaces any persistent cookie with the same name, domain and path
+        record(RecordRemove, cookie.toRawForm());
+        return;
+    }
+    record(RecordInsert, cookie.toRawForm());
+}
+
+void CookieJournal::recordRemove(const QNetworkCookie& cookie)
+{
+    record(RecordRemove, cookie.toRawForm());
+}
+
+void CookieJournal::recordClear()
+{
+    record(RecordClear, QByteArray());
+}
+
+bool CookieJournal::hasPendingRecords() const
+{
+    return m_pendingRecords > 0;
+}
+
+bool CookieJournal::needsCompaction(int cookieCount) const
+{
+    const int records = m_records + m_pendingRecords;
+    return m_damaged || (records >= COMPACTION_MIN_RECORDS && records > COMPACTION_FACTOR * cookieCount);
+}
+
+bool CookieJournal::append(CookieStore& store)
+{
+    if (m_pending.isEmpty()) {
+        return true;
+    }
+    if (!lock()) {
+        // Keep the records: they are written with the next save
+        return false;
+    }
+
+    // Catch up with other processes first, so their records land before ours
+    if (readRecords(store)) {
+        reapplyPending(store);
+    }
+    if (m_damaged) {
+        const bool written = writeSnapshot(store.all());
+        m_lock.unlock();
+        return written;
+    }
+
+    QFile file(m_path);
+    bool written = file.open(QIODevice::WriteOnly | QIODevice::Append);
+    if (written && file.size() == 0) {
+        m_fileId = QUuid::createUuid().toRfc4122();
+        m_records = 0;
+        QDataStream out(&file);
+        writeHeader(out, m_fileId);
+    }
+    if (written && file.write(m_pending) != m_pending.size()) {
+        // The journal may now end with a partial record: rewrite it on next save
+        m_damaged = true;
+        written = false;
+    }
+    if (written) {
+        m_offset = file.pos();
+        m_records += m_pendingRecords;
+        m_pending.clear();
+        m_pendingRecords = 0;
+    } else {
+        qWarning() << "CookieJar - Unable to write cookie journal:" << m_path << file.errorString();
+    }
+
+    m_lock.unlock();
+    return written;
+}
+
+bool CookieJournal::compact(CookieStore& store)
+{
+    if (!lock()) {
+        return false;
+    }
+
+    // Don't drop what other processes appended since we last looked
+    if (readRecords(store)) {
+        reapplyPending(store);
+    }
+    const bool written = writeSnapshot(store.all());
+
+    m_lock.unlock();
+    return written;
+}
+
+// private:
+bool CookieJournal::lock()
+{
+    if (!m_lock.tryLock(LOCK_TIMEOUT)) {
+        qWarning() << "CookieJar - Unable to lock cookie journal:" << m_lock.error() << m_path;
+        return false;
+    }
+    return true;
+}
+
+bool CookieJournal::isUpToDate() const
+{
+    // Checked without the lock: a write in progress shows as a different size
+    QFile file(m_path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return m_fileId.isEmpty();
+    }
+    if (file.size() != m_offset) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_5);
+    quint32 magic = 0, version = 0;
+    QByteArray fileId;
+    in >> magic >> version >> fileId;
+    return in.status() == QDataStream::Ok && fileId == m_fileId;
+}
+
+bool CookieJournal::readRecords(CookieStore& store, bool* isJournal)
+{
+    QFile file(m_path);
+    if (!file.open(QIODevice::ReadOnly) || file.size() == 0) {
+        // Nothing saved yet: the header is written with the first records
+        return false;
+    }
+
+    // Read straight from the mapped file; fall back to reading it when it can't be mapped
+    const qint64 size = file.size();
+    uchar* mapped = file.map(0, size);
+    const QByteArray data = mapped ?
+                            QByteArray::fromRawData(reinterpret_cast<const char*>(mapped), size) :
+                            file.readAll();
+
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_5_5);
+
+    quint32 magic = 0, version = 0;
+    QByteArray fileId;
+    in >> magic >> version;
+    if (in.status() != QDataStream::Ok || magic != JOURNAL_MAGIC) {
+        if (isJournal) {
+            *isJournal = false;
+        }
+        return false;
+    }
+    in >> fileId;
+    if (version != JOURNAL_VERSION || in.status() != QDataStream::Ok) {
+        qWarning() << "CookieJar - Unsupported cookie journal version" << version << "in" << m_path;
+        m_damaged = true;
+        return false;
+    }
+
+    bool changed = false;
+    if (fileId != m_fileId || size < m_offset) {
+        // First read, or another process compacted the journal: replay it from the start
+        if (!m_fileId.isEmpty() || store.count() > 0) {
+            clearPersistentCookies(store);
+            changed = true;
+        }
+        m_fileId = fileId;
+        m_offset = in.device()->pos();
+        m_records = 0;
+        m_damaged = false;
+    }
+
+    in.device()->seek(m_offset);
+    const int records = applyRecords(store, in, &m_offset);
+    m_records += records;
+
+    if (mapped) {
+        file.unmap(mapped);
+    }
+    return changed || records > 0;
+}
+
+int CookieJournal::applyRecords(CookieStore& store, QDataStream& in, qint64* offset)
+{
+    int records = 0;
+    while (!in.atEnd()) {
+        quint8 type;
+        QByteArray rawCookie;
+        in >> type >> rawCookie;
+        if (in.status() != QDataStream::Ok) {
+            // Most likely a write interrupted by a crash: keep what was replayed so far
+            qWarning() << "CookieJar - Ignoring damaged end of cookie journal:" << m_path;
+            m_damaged = true;
+            break;
+        }
+        ++records;
+        if (offset) {
+            *offset = in.device()->pos();
+        }
+
+        if (type == RecordClear) {
+            clearPersistentCookies(store);
+            continue;
+        }
+
+        QList<QNetworkCookie> cookies = QNetworkCookie::parseCookies(rawCookie);
+        if (cookies.isEmpty() || (type != RecordInsert && type != RecordRemove)) {
+            qWarning() << "CookieJar - Unable to parse journal record:" << rawCookie;
+            m_damaged = true;
+            continue;
+        }
+        foreach(const QNetworkCookie & cookie, cookies) {
+            if (type == RecordInsert) {
+                // Left behind by older versions, which journaled session cookies too
+                if (cookie.isSessionCookie()) {
+                    continue;
+                }
+                store.insert(cookie);
+            } else {
+                // Journaled removals can only be about persistent cookies
+                store.removePersistent(cookie);
+            }
+        }
+    }
+    return records;
+}
+
+void CookieJournal::reapplyPending(CookieStore& store)
+{
+    if (m_pending.isEmpty()) {
+        return;
+    }
+
+    QDataStream in(m_pending);
+    in.setVersion(QDataStream::Qt_5_5);
+    applyRecords(store, in, 0);
+}
+
+bool CookieJournal::writeSnapshot(const QList<QNetworkCookie>& cookies)
+{
+    // QSaveFile writes a temporary file and renames it over the journal on commit
+    QSaveFile file(m_path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "CookieJar - Unable to write cookie journal:" << m_path << file.errorString();
+        return false;
+    }
+
+    const QByteArray fileId = QUuid::createUuid().toRfc4122();
+    QDataStream out(&file);
+    writeHeader(out, fileId);
+    int records = 0;
+    foreach(const QNetworkCookie & cookie, cookies) {
+        if (!cookie.isSessionCookie()) {
+            out << quint8(RecordInsert) << cookie.toRawForm();
+            ++records;
+        }
+    }
+    const qint64 size = file.pos();
+    if (!file.commit()) {
+        qWarning() << "CookieJar - Unable to write cookie journal:" << m_path << file.errorString();
+        return false;
+    }
+
+    m_fileId = fileId;
+    m_offset = size;
+    m_records = records;
+    m_pending.clear();
+    m_pendingRecords = 0;
+    m_damaged = false;
+    return true;
+}
+
+void CookieJournal::record(char type, const QByteArray& rawCookie)
+{
+    QDataStream out(&m_pending, QIODevice::WriteOnly | QIODevice::Append);
+    out.setVersion(QDataStream::Qt_5_5);
+    out << quint8(type) << rawCookie;
+    ++m_pendingRecords;
+}
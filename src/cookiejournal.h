@@ -0,0 +1,117 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef COOKIEJOURNAL_H
+#define COOKIEJOURNAL_H
+
+#include <QByteArray>
+#include <QList>
+#include <QLockFile>
+#include <QNetworkCookie>
+#include <QString>
+
+class CookieStore;
+class QDataStream;
+
+/**
+ * Append-only on-disk format for CookieJar ("--cookies-file-format=journal").
+ *
+ * The file starts with a small header, followed by one record per change:
+ * a cookie was set, a cookie was deleted, or the whole jar was cleared.
+ * Saving only appends the records collected since the last save; loading
+ * maps the file in memory and replays it. Once the journal holds many more
+ * records than live cookies, it is compacted: rewritten with one record per
+ * cookie, through a temporary file renamed over the journal.
+ *
+ * A journal can be shared by several processes. Every access happens under
+ * a lock file ("<path>.lock"), and each journal remembers how far it has
+ * read: before writing, and whenever "refresh()" is called, it replays the
+ * records other processes appended since. A compaction gives the journal a
+ * new id in its header, which tells the other processes to replay it from
+ * the start. Records not written yet are applied again on top of whatever
+ * was read, so they keep winning over older changes from other processes.
+ *
+ * Session cookies are never journaled: they only live in the memory of the
+ * process that set them, and are gone when it exits (as with the INI format).
+ * Setting one records the removal of the persistent cookie it replaces, and
+ * replayed records never touch the session cookies of this process.
+ */
+class CookieJournal
+{
+public:
+    explicit CookieJournal(const QString& path);
+
+    QString path() const;
+
+    /// @return true if @p path exists and is a cookie journal
+    static bool isJournal(const QString& path);
+
+    /**
+     * Replay the journal into @p store.
+     * @return false if the file exists but is not a cookie journal
+     */
+    bool replay(CookieStore& store);
+
+    /**
+     * Replay into @p store the records appended by other processes.
+     * @return true if @p store changed
+     */
+    bool refresh(CookieStore& store);
+
+    void recordInsert(const QNetworkCookie& cookie);
+    void recordRemove(const QNetworkCookie& cookie);
+    void recordClear();
+
+    bool hasPendingRecords() const;
+    bool needsCompaction(int cookieCount) const;
+
+    /// Append the records collected since the last write
+    bool append(CookieStore& store);
+    /// Replace the journal with one record per cookie in @p store
+    bool compact(CookieStore& store);
+
+private:
+    bool lock();
+    bool isUpToDate() const;
+    bool readRecords(CookieStore& store, bool* isJournal = 0);
+    int applyRecords(CookieStore& store, QDataStream& in, qint64* offset);
+    void reapplyPending(CookieStore& store);
+    bool writeSnapshot(const QList<QNetworkCookie>& cookies);
+    void record(char type, const QByteArray& rawCookie);
+
+    QString m_path;
+    QLockFile m_lock;
+    QByteArray m_fileId;
+    qint64 m_offset;
+    QByteArray m_pending;
+    int m_pendingRecords;
+    int m_records;
+    bool m_damaged;
+};
+
+#endif // COOKIEJOURNAL_H
@@ -0,0 +1,298 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "cookiestore.h"
+
+#include <QDateTime>
+
+#include <algorithm>
+
+// Once stale heap nodes (left behind by replaced or deleted cookies) outnumber
+// live cookies by this factor, the heap is rebuilt
+#define EXPIRY_HEAP_SLACK       2
+
+// Orders the expiry heap so the cookie expiring first is on top
+struct ExpiresLater {
+    template<typename T>
+    bool operator()(const T& a, const T& b) const
+    {
+        return a.expiresAt > b.expiresAt;
+    }
+};
+
+// Same semantics as the helpers QNetworkCookieJar uses internally
+static bool isParentDomain(const QString& domain, const QString& reference)
+{
+    if (!reference.startsWith(QLatin1Char('.'))) {
+        return domain == reference;
+    }
+    return domain.endsWith(reference) || domain == reference.mid(1);
+}
+
+static bool isParentPath(const QString& path, const QString& reference)
+{
+    if (path.startsWith(reference)) {
+        // "/foo/" matches "/foo/bar"; "/foo" matches "/foo" and "/foo/bar" but not "/foobar"
+        return reference.endsWith(QLatin1Char('/'))
+               || path.length() == reference.length()
+               || path.at(reference.length()) == QLatin1Char('/');
+    }
+    return false;
+}
+
+CookieStore::CookieStore()
+    : m_sequence(0)
+    , m_count(0)
+{
+}
+
+void CookieStore::insert(const QNetworkCookie& cookie)
+{
+    remove(cookie);
+
+    const QString key = registrableDomain(cookie.domain());
+    QList<Entry>& bucket = m_buckets[key];
+
+    Entry entry;
+    entry.cookie = cookie;
+    entry.sequence = ++m_sequence;
+
+    // Keep the bucket ordered by decreasing path length; among cookies with
+    // paths of the same length, older cookies come first
+    const int pathLength = cookie.path().length();
+    int i = 0;
+    while (i < bucket.size() && bucket.at(i).cookie.path().length() >= pathLength) {
+        ++i;
+    }
+    bucket.insert(i, entry);
+    ++m_count;
+
+    if (!cookie.isSessionCookie()) {
+        pushExpiry(entry, key);
+    }
+}
+
+bool CookieStore::remove(const QNetworkCookie& cookie)
+{
+    return remove(cookie, true);
+}
+
+bool CookieStore::removePersistent(const QNetworkCookie& cookie)
+{
+    return remove(cookie, false);
+}
+
+bool CookieStore::contains(const QNetworkCookie& cookie) const
+{
+    QHash<QString, QList<Entry> >::const_iterator bucket = m_buckets.constFind(registrableDomain(cookie.domain()));
+    if (bucket == m_buckets.constEnd()) {
+        return false;
+    }
+
+    foreach(const Entry & entry, *bucket) {
+        if (entry.cookie == cookie) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void CookieStore::clear()
+{
+    m_buckets.clear();
+    m_expiries.clear();
+    m_count = 0;
+}
+
+int CookieStore::count() const
+{
+    return m_count;
+}
+
+QList<QNetworkCookie> CookieStore::all() const
+{
+    QVector<const Entry*> entries;
+    entries.reserve(m_count);
+    QHash<QString, QList<Entry> >::const_iterator bucket = m_buckets.constBegin();
+    for (; bucket != m_buckets.constEnd(); ++bucket) {
+        for (int i = 0; i < bucket->size(); ++i) {
+            entries.append(&bucket->at(i));
+        }
+    }
+    std::sort(entries.begin(), entries.end(), insertedBefore);
+
+    QList<QNetworkCookie> result;
+    result.reserve(entries.size());
+    foreach(const Entry * entry, entries) {
+        result.append(entry->cookie);
+    }
+    return result;
+}
+
+QList<QNetworkCookie> CookieStore::forUrl(const QUrl& url) const
+{
+    QList<QNetworkCookie> result;
+
+    const QString host = url.host();
+    QHash<QString, QList<Entry> >::const_iterator bucket = m_buckets.constFind(registrableDomain(host));
+    if (bucket == m_buckets.constEnd()) {
+        return result;
+    }
+
+    const QString path = url.path();
+    const bool isEncrypted = url.scheme().toLower() == QLatin1String("https");
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+
+    // The bucket is already in the order cookies have to be sent in
+    foreach(const Entry & entry, *bucket) {
+        const QNetworkCookie& cookie = entry.cookie;
+        if (!isParentDomain(host, cookie.domain())) {
+            continue;
+        }
+        if (!isParentPath(path, cookie.path())) {
+            continue;
+        }
+        if (!cookie.isSessionCookie() && cookie.expirationDate() < now) {
+            continue;
+        }
+        if (cookie.isSecure() && !isEncrypted) {
+            continue;
+        }
+        result.append(cookie);
+    }
+    return result;
+}
+
+QList<QNetworkCookie> CookieStore::takeExpired(qint64 now)
+{
+    QList<QNetworkCookie> expired;
+
+    while (!m_expiries.isEmpty() && m_expiries.first().expiresAt < now) {
+        std::pop_heap(m_expiries.begin(), m_expiries.end(), ExpiresLater());
+        const Expiry expiry = m_expiries.takeLast();
+
+        QHash<QString, QList<Entry> >::iterator bucket = m_buckets.find(expiry.bucket);
+        if (bucket == m_buckets.end()) {
+            continue;
+        }
+        for (int i = 0; i < bucket->size(); ++i) {
+            if (bucket->at(i).sequence == expiry.sequence) {
+                expired.append(bucket->at(i).cookie);
+                bucket->removeAt(i);
+                if (bucket->isEmpty()) {
+                    m_buckets.erase(bucket);
+                }
+                --m_count;
+                break;
+            }
+        }
+    }
+    return expired;
+}
+
+// private:
+bool CookieStore::insertedBefore(const Entry* a, const Entry* b)
+{
+    return a->sequence < b->sequence;
+}
+
+QString CookieStore::registrableDomain(const QString& domain)
+{
+    const QString host = domain.startsWith(QLatin1Char('.')) ? domain.mid(1).toLower() : domain.toLower();
+
+    // "a.b.example.co.uk" -> ".co.uk"; empty for unknown suffixes, IP addresses and "localhost"
+    QUrl url;
+    url.setHost(host);
+    const int suffixLength = url.topLevelDomain().length();
+    if (suffixLength >= host.length()) {
+        return host;
+    }
+
+    // Keep the label right before the public suffix (or the last label, when
+    // the suffix is unknown). A host and every domain that can set cookies
+    // for it share this key, because a cookie domain can't be a public suffix.
+    const int labelStart = host.lastIndexOf(QLatin1Char('.'), host.length() - suffixLength - 1);
+    return host.mid(labelStart + 1);
+}
+
+bool CookieStore::remove(const QNetworkCookie& cookie, bool sessionToo)
+{
+    QHash<QString, QList<Entry> >::iterator bucket = m_buckets.find(registrableDomain(cookie.domain()));
+    if (bucket == m_buckets.end()) {
+        return false;
+    }
+
+    for (int i = 0; i < bucket->size(); ++i) {
+        if (bucket->at(i).cookie.hasSameIdentifier(cookie)) {
+            if (!sessionToo && bucket->at(i).cookie.isSessionCookie()) {
+                return false;
+            }
+            // The matching heap node, if any, is dropped lazily by "takeExpired()"
+            bucket->removeAt(i);
+            if (bucket->isEmpty()) {
+                m_buckets.erase(bucket);
+            }
+            --m_count;
+            return true;
+        }
+    }
+    return false;
+}
+
+void CookieStore::pushExpiry(const Entry& entry, const QString& bucket)
+{
+    if (m_expiries.size() > EXPIRY_HEAP_SLACK * m_count + 64) {
+        rebuildExpiries();
+    }
+
+    Expiry expiry;
+    expiry.expiresAt = entry.cookie.expirationDate().toMSecsSinceEpoch();
+    expiry.sequence = entry.sequence;
+    expiry.bucket = bucket;
+    m_expiries.append(expiry);
+    std::push_heap(m_expiries.begin(), m_expiries.end(), ExpiresLater());
+}
+
+void CookieStore::rebuildExpiries()
+{
+    m_expiries.clear();
+
+    QHash<QString, QList<Entry> >::const_iterator bucket = m_buckets.constBegin();
+    for (; bucket != m_buckets.constEnd(); ++bucket) {
+        foreach(const Entry & entry, bucket.value()) {
+            if (!entry.cookie.isSessionCookie()) {
+                Expiry expiry;
+                expiry.expiresAt = entry.cookie.expirationDate().toMSecsSinceEpoch();
+                expiry.sequence = entry.sequence;
+                expiry.bucket = bucket.key();
+                m_expiries.append(expiry);
+            }
+        }
+    }
+    std::make_heap(m_expiries.begin(), m_expiries.end(), ExpiresLater());
+}
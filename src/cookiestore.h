@@ -0,0 +1,104 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef COOKIESTORE_H
+#define COOKIESTORE_H
+
+#include <QHash>
+#include <QList>
+#include <QNetworkCookie>
+#include <QString>
+#include <QUrl>
+#include <QVector>
+
+/**
+ * In-memory cookie storage used by CookieJar in place of the flat list kept
+ * by QNetworkCookieJar.
+ *
+ * Cookies are bucketed by registrable domain (e.g. "example.co.uk" for
+ * ".www.example.co.uk"), so a lookup only looks at the cookies that could
+ * possibly match the host. Each bucket is kept ordered by decreasing path
+ * length, which is the order cookies have to be sent in. Non-session cookies
+ * are also tracked in a min-heap on their expiration date, so purging
+ * expired cookies does not have to scan the whole store.
+ *
+ * Matching rules are the same as QNetworkCookieJar::cookiesForUrl().
+ *
+ * All the containers are implicitly shared: copying a store is cheap, and
+ * its data is only duplicated when one of the copies changes.
+ */
+class CookieStore
+{
+public:
+    CookieStore();
+
+    /// Add @p cookie, replacing any cookie with the same name, domain and path
+    void insert(const QNetworkCookie& cookie);
+    /// Remove the cookie with the same name, domain and path as @p cookie
+    bool remove(const QNetworkCookie& cookie);
+    /// Same as remove(), but a matching session cookie is left in place
+    bool removePersistent(const QNetworkCookie& cookie);
+    bool contains(const QNetworkCookie& cookie) const;
+    void clear();
+
+    int count() const;
+
+    /// All cookies, in insertion order
+    QList<QNetworkCookie> all() const;
+
+    /// Cookies to send with a request to @p url, most specific path first
+    QList<QNetworkCookie> forUrl(const QUrl& url) const;
+
+    /// Remove and return all cookies that expired before @p now (msecs since epoch)
+    QList<QNetworkCookie> takeExpired(qint64 now);
+
+private:
+    struct Entry {
+        QNetworkCookie cookie;
+        quint64 sequence;
+    };
+
+    struct Expiry {
+        qint64 expiresAt;
+        quint64 sequence;
+        QString bucket;
+    };
+
+    static bool insertedBefore(const Entry* a, const Entry* b);
+    static QString registrableDomain(const QString& domain);
+    bool remove(const QNetworkCookie& cookie, bool sessionToo);
+    void pushExpiry(const Entry& entry, const QString& bucket);
+    void rebuildExpiries();
+
+    QHash<QString, QList<Entry> > m_buckets;
+    QVector<Expiry> m_expiries;
+    quint64 m_sequence;
+    int m_count;
+};
+
+#endif // COOKIESTORE_H
@@ -0,0 +1,234 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "downloadmanager.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QNetworkReply>
+#include <QRegExp>
+
+// Largest chunk held in memory (by us and by the reply) at any time
+const qint64 DOWNLOAD_BUFFER_SIZE = 64 * 1024;
+// Minimum time between two "downloadProgress" signals for the same download, in ms
+const qint64 DOWNLOAD_PROGRESS_INTERVAL = 250;
+
+DownloadManager::DownloadManager(QObject* parent)
+    : QObject(parent)
+    , m_idCounter(0)
+{
+    m_clock.start();
+}
+
+QString DownloadManager::directory() const
+{
+    return m_directory;
+}
+
+void DownloadManager::setDirectory(const QString& directory)
+{
+    m_directory = directory;
+}
+
+int DownloadManager::activeCount() const
+{
+    return m_downloads.size();
+}
+
+// public slots:
+void DownloadManager::handleUnsupportedContent(QNetworkReply* reply)
+{
+    if (!reply || m_directory.isEmpty() || m_downloads.contains(reply)) {
+        return;
+    }
+
+    QDir().mkpath(m_directory);
+
+    Download download;
+    download.id = ++m_idCounter;
+    download.url = reply->url().toEncoded();
+    download.file = new QFile(fileNameFor(reply), this);
+    download.bytesReceived = 0;
+    download.bytesTotal = reply->header(QNetworkRequest::ContentLengthHeader).isValid() ?
+                          reply->header(QNetworkRequest::ContentLengthHeader).toLongLong() : -1;
+    download.lastProgressAt = m_clock.elapsed();
+
+    emit downloadStarted(toVariantMap(download));
+
+    if (!download.file->open(QIODevice::WriteOnly)) {
+        finish(download, download.file->errorString());
+        reply->abort();
+        return;
+    }
+
+    // Don't let the reply buffer more than we are going to write in one go
+    reply->setReadBufferSize(DOWNLOAD_BUFFER_SIZE);
+    m_downloads[reply] = download;
+
+    connect(reply, SIGNAL(readyRead()), SLOT(handleReadyRead()));
+    connect(reply, SIGNAL(finished()), SLOT(handleFinished()));
+    connect(reply, SIGNAL(destroyed(QObject*)), SLOT(handleDestroyed(QObject*)));
+
+    // WebKit may have received part (or all) of the reply already
+    if (reply->isFinished()) {
+        finishReply(reply);
+    } else if (reply->bytesAvailable() > 0) {
+        readReply(reply);
+    }
+}
+
+// private slots:
+void DownloadManager::handleReadyRead()
+{
+    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
+    if (m_downloads.contains(reply)) {
+        readReply(reply);
+    }
+}
+
+void DownloadManager::handleFinished()
+{
+    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
+    if (m_downloads.contains(reply)) {
+        finishReply(reply);
+    }
+}
+
+void DownloadManager::handleDestroyed(QObject* reply)
+{
+    // Only the address is used: the reply is already gone
+    QNetworkReply* key = static_cast<QNetworkReply*>(reply);
+    if (m_downloads.contains(key)) {
+        finish(m_downloads.take(key), "Download interrupted");
+    }
+}
+
+// private:
+void DownloadManager::readReply(QNetworkReply* reply)
+{
+    Download& download = m_downloads[reply];
+    if (!drain(reply, download)) {
+        const Download failed = m_downloads.take(reply);
+        disconnect(reply, 0, this, 0);
+        reply->abort();
+        finish(failed, failed.file->errorString());
+        return;
+    }
+
+    const qint64 now = m_clock.elapsed();
+    if (now - download.lastProgressAt >= DOWNLOAD_PROGRESS_INTERVAL) {
+        download.lastProgressAt = now;
+        emit downloadProgress(toVariantMap(download));
+    }
+}
+
+void DownloadManager::finishReply(QNetworkReply* reply)
+{
+    QString errorString;
+    if (!drain(reply, m_downloads[reply])) {
+        errorString = m_downloads[reply].file->errorString();
+    } else if (reply->error() != QNetworkReply::NoError) {
+        errorString = reply->errorString();
+    }
+
+    const Download download = m_downloads.take(reply);
+    disconnect(reply, 0, this, 0);
+    finish(download, errorString);
+}
+
+QString DownloadManager::fileNameFor(const QNetworkReply* reply) const
+{
+    QString name;
+
+    QRegExp filename("filename\\s*=\\s*\"?([^\";]+)\"?", Qt::CaseInsensitive);
+    if (filename.indexIn(QString::fromUtf8(reply->rawHeader("Content-Disposition"))) != -1) {
+        name = filename.cap(1).trimmed();
+    }
+    if (name.isEmpty()) {
+        name = QFileInfo(reply->url().path()).fileName();
+    }
+    // Never let the server pick the directory
+    name = QFileInfo(name).fileName();
+    if (name.isEmpty() || name.startsWith('.')) {
+        name = "download" + name;
+    }
+
+    const QDir dir(m_directory);
+    const QFileInfo info(name);
+    const QString suffix = info.suffix().isEmpty() ? QString() : "." + info.suffix();
+    QString path = dir.filePath(name);
+    for (int i = 1; QFile::exists(path); ++i) {
+        path = dir.filePath(QString("%1-%2%3").arg(info.completeBaseName()).arg(i).arg(suffix));
+    }
+    return path;
+}
+
+bool DownloadManager::drain(QNetworkReply* reply, Download& download)
+{
+    if (m_buffer.size() != DOWNLOAD_BUFFER_SIZE) {
+        m_buffer.resize(DOWNLOAD_BUFFER_SIZE);
+    }
+
+    qint64 size;
+    while ((size = reply->read(m_buffer.data(), m_buffer.size())) > 0) {
+        if (download.file->write(m_buffer.constData(), size) != size) {
+            return false;
+        }
+        download.bytesReceived += size;
+    }
+    return true;
+}
+
+void DownloadManager::finish(const Download& download, const QString& errorString)
+{
+    download.file->close();
+
+    QVariantMap data = toVariantMap(download);
+    if (errorString.isEmpty()) {
+        data["status"] = "success";
+    } else {
+        // Don't leave a truncated file behind
+        download.file->remove();
+        data["status"] = "fail";
+        data["errorString"] = errorString;
+    }
+    download.file->deleteLater();
+
+    emit downloadFinished(data);
+}
+
+QVariantMap DownloadManager::toVariantMap(const Download& download) const
+{
+    QVariantMap data;
+    data["id"] = download.id;
+    data["url"] = download.url.data();
+    data["fileName"] = download.file->fileName();
+    data["bytesReceived"] = download.bytesReceived;
+    data["bytesTotal"] = download.bytesTotal;
+    return data;
+}
@@ -0,0 +1,97 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DOWNLOADMANAGER_H
+#define DOWNLOADMANAGER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QVariantMap>
+
+class QFile;
+class QNetworkReply;
+
+/**
+ * Saves the replies WebKit can't display (attachments, archives, exports...)
+ * into a directory, streaming them through a fixed-size buffer.
+ *
+ * The reply's own read buffer is capped too, so the network is throttled
+ * to the speed of the disk instead of piling up data in memory.
+ * Downloads are disabled (and unsupported content ignored, as before)
+ * while no directory is set.
+ */
+class DownloadManager : public QObject
+{
+    Q_OBJECT
+
+public:
+    DownloadManager(QObject* parent = 0);
+
+    QString directory() const;
+    void setDirectory(const QString& directory);
+
+    int activeCount() const;
+
+public slots:
+    void handleUnsupportedContent(QNetworkReply* reply);
+
+signals:
+    void downloadStarted(const QVariant& data);
+    void downloadProgress(const QVariant& data);
+    void downloadFinished(const QVariant& data);
+
+private slots:
+    void handleReadyRead();
+    void handleFinished();
+    void handleDestroyed(QObject* reply);
+
+private:
+    struct Download {
+        int id;
+        QByteArray url;
+        QFile* file;
+        qint64 bytesReceived;
+        qint64 bytesTotal;
+        qint64 lastProgressAt;
+    };
+
+    void readReply(QNetworkReply* reply);
+    void finishReply(QNetworkReply* reply);
+    QString fileNameFor(const QNetworkReply* reply) const;
+    bool drain(QNetworkReply* reply, Download& download);
+    void finish(const Download& download, const QString& errorString);
+    QVariantMap toVariantMap(const Download& download) const;
+
+    QString m_directory;
+    QHash<QNetworkReply*, Download> m_downloads;
+    QByteArray m_buffer;
+    QElapsedTimer m_clock;
+    int m_idCounter;
+};
+
+#endif // DOWNLOADMANAGER_H
@@ -32,15 +32,35 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QDir>
+#include <QDirIterator>
 #include <QDebug>
 #include <QDateTime>
+#include <QFileSystemWatcher>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
+
+#ifdef Q_OS_LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// TreeJob reports progress every this many files
+#define TREE_JOB_PROGRESS_INTERVAL  100
 
 // File
 // public:
 File::File(QFile* openfile, QTextCodec* codec, QObject* parent) :
     QObject(parent),
     m_file(openfile),
-    m_fileStream(0)
+    m_fileStream(0),
+    m_mapped(0),
+    m_mappedSize(0)
 {
     if (codec) {
         m_fileStream = new QTextStream(m_file);
@@ -106,12 +126,57 @@ QString File::read(const QVariant& n)
         } else {
             data = m_file->read(bytesToRead);
         }
-        QString ret(data.size(), ' ');
-        for (int i = 0; i < data.size(); ++i) {
-            ret[i] = data.at(i);
+        // Latin-1 maps every byte to the character with the same code, '\0' included
+        return QString::fromLatin1(data);
+    }
+}
+
+QByteArray File::readBytes(const QVariant& n)
+{
+    qint64 bytesToRead = -1;
+    if (n.canConvert(QVariant::LongLong)) {
+        bytesToRead = n.toLongLong();
+    }
+
+    if (!m_file->isReadable()) {
+        qDebug() << "File::readBytes - " << "Couldn't read:" << m_file->fileName();
+        return QByteArray();
+    }
+    if (m_file->isWritable()) {
+        // make sure we write everything to disk before reading
+        flush();
+    }
+
+    if (0 <= bytesToRead) {
+        if (m_fileStream) {
+            qDebug() << "File::readBytes - " << "Text files can only be read whole:" << m_file->fileName();
+            return QByteArray();
         }
-        return ret;
+        return m_file->read(bytesToRead);
+    }
+
+    // Like "read()", read the whole file whatever the current position.
+    // The mapping stays valid until the file is closed, and the bytes are
+    // copied only once: straight into the JavaScript array.
+    const qint64 size = m_file->size();
+    if (m_mapped && m_mappedSize != size) {
+        // The file changed size since it was mapped
+        _unmap();
     }
+    if (!m_mapped && size > 0) {
+        m_mapped = m_file->map(0, size);
+        m_mappedSize = m_mapped ? size : 0;
+    }
+    if (m_mapped) {
+        return QByteArray::fromRawData(reinterpret_cast<const char*>(m_mapped), m_mappedSize);
+    }
+
+    // Not a regular file (e.g. a pipe), or an empty one
+    const qint64 pos = m_file->pos();
+    m_file->seek(0);
+    const QByteArray data = m_file->readAll();
+    m_file->seek(pos);
+    return data;
 }
 
 bool File::write(const QString& data)
@@ -128,13 +193,53 @@ bool File::write(const QString& data)
         }
         return true;
     } else {
-        // binary file
-        QByteArray bytes(data.size(), Qt::Uninitialized);
-        for (int i = 0; i < data.size(); ++i) {
-            bytes[i] = data.at(i).toLatin1();
+        // binary file: one character per byte
+        return m_file->write(data.toLatin1());
+    }
+}
+
+bool File::writeBytes(const QByteArray& data)
+{
+    if (!m_file->isWritable()) {
+        qDebug() << "File::writeBytes - " << "Couldn't write:" << m_file->fileName();
+        return false;
+    }
+    if (m_fileStream) {
+        // text file: keep the bytes after the text already written
+        m_fileStream->flush();
+    }
+    return m_file->write(data) == data.size();
+}
+
+bool File::writeBatch(const QVariantList& chunks)
+{
+    if (!m_file->isWritable()) {
+        qDebug() << "File::writeBatch - " << "Couldn't write:" << m_file->fileName();
+        return false;
+    }
+
+    if (m_fileStream) {
+        // text file
+        foreach(const QVariant & chunk, chunks) {
+            if (chunk.type() == QVariant::ByteArray) {
+                m_fileStream->flush();
+                m_file->write(chunk.toByteArray());
+            } else {
+                (*m_fileStream) << chunk.toString();
+            }
         }
-        return m_file->write(bytes);
+        if (_isUnbuffered()) {
+            m_fileStream->flush();
+        }
+        return true;
     }
+
+    // binary file: gather the chunks, so they take a single write
+    QByteArray bytes;
+    foreach(const QVariant & chunk, chunks) {
+        bytes.append(chunk.type() == QVariant::ByteArray ? chunk.toByteArray() : chunk.toString().toLatin1());
+    }
+    return m_file->write(bytes) == bytes.size();
 }
 
 bool File::seek(const qint64 pos)
@@ -167,7 +272,8 @@ QString File::readLine()
 
 bool File::writeLine(const QString& data)
 {
-    if (write(data) && write("\n")) {
+    // A single write: unbuffered files are flushed once per line
+    if (write(data + QLatin1Char('\n'))) {
         return true;
     }
     qDebug() << "File::writeLine - " << "Couldn't write:" << m_file->fileName();
@@ -209,6 +315,7 @@ void File::close()
         m_fileStream = 0;
     }
     if (m_file) {
+        _unmap();
         m_file->close();
         delete m_file;
         m_file = NULL;
@@ -267,6 +374,395 @@ bool File::_isUnbuffered() const
     return m_file->openMode() & QIODevice::Unbuffered;
 }
 
+void File::_unmap()
+{
+    if (m_mapped) {
+        m_file->unmap(m_mapped);
+        m_mapped = 0;
+        m_mappedSize = 0;
+    }
+}
+
+
+#ifdef Q_OS_LINUX
+static bool copyFileData(int in, int out, off_t size)
+{
+#ifdef FICLONE
+    // Share the data blocks instead of copying them (btrfs, XFS...)
+    if (::ioctl(out, FICLONE, in) == 0) {
+        return true;
+    }
+#endif
+#ifdef __NR_copy_file_range
+    // Copy inside the kernel, or on the server for network file systems
+    off_t remaining = size;
+    while (remaining > 0) {
+        const ssize_t copied = ::syscall(__NR_copy_file_range, in, NULL, out, NULL, size_t(remaining), 0u);
+        if (copied <= 0) {
+            break;
+        }
+        remaining -= copied;
+    }
+    if (remaining == 0) {
+        return true;
+    }
+    // Not supported here (e.g. across file systems): start over with plain reads and writes
+    if (::ftruncate(out, 0) != 0 || ::lseek(in, 0, SEEK_SET) != 0 || ::lseek(out, 0, SEEK_SET) != 0) {
+        return false;
+    }
+#else
+    Q_UNUSED(size);
+#endif
+
+    char buffer[64 * 1024];
+    for (;;) {
+        const ssize_t bytesRead = ::read(in, buffer, sizeof(buffer));
+        if (bytesRead == 0) {
+            return true;
+        }
+        if (bytesRead < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        for (ssize_t written = 0; written < bytesRead;) {
+            const ssize_t bytesWritten = ::write(out, buffer + written, bytesRead - written);
+            if (bytesWritten < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            written += bytesWritten;
+        }
+    }
+}
+#endif
+
+// Same result as QFile::copy(): the destination must not exist, and gets the source permissions
+static bool copyFile(const QString& source, const QString& destination)
+{
+#ifdef Q_OS_LINUX
+    const QByteArray destinationPath = QFile::encodeName(destination);
+    const int in = ::open(QFile::encodeName(source).constData(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        return false;
+    }
+    struct stat info;
+    if (::fstat(in, &info) != 0) {
+        ::close(in);
+        return false;
+    }
+    const int out = ::open(destinationPath.constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (out < 0) {
+        ::close(in);
+        return false;
+    }
+
+    bool copied = copyFileData(in, out, info.st_size) && ::fchmod(out, info.st_mode & 07777) == 0;
+    copied = ::close(out) == 0 && copied;
+    ::close(in);
+    if (!copied) {
+        ::unlink(destinationPath.constData());
+    }
+    return copied;
+#else
+    return QFile::copy(source, destination);
+#endif
+}
+
+
+// TreeJob
+class TreeJobTask : public QRunnable
+{
+public:
+    TreeJobTask(TreeJob* job, bool isScan)
+        : m_job(job)
+        , m_isScan(isScan)
+    { }
+
+    void run()
+    {
+        if (m_isScan) {
+            m_job->scan();
+        } else {
+            m_job->processFiles();
+        }
+    }
+
+private:
+    TreeJob* m_job;
+    bool m_isScan;
+};
+
+// public:
+TreeJob::TreeJob(Operation operation, const QString& source, const QString& destination, QObject* parent)
+    : QObject(parent)
+    , m_operation(operation)
+    , m_source(source)
+    , m_destination(destination)
+{
+}
+
+void TreeJob::start()
+{
+    QThreadPool::globalInstance()->start(new TreeJobTask(this, true));
+}
+
+void TreeJob::scan()
+{
+    // Like "_copyTree()" and "_removeTree()", a missing source is nothing to do
+    QDir root(m_source);
+    if (!root.exists()) {
+        QMetaObject::invokeMethod(this, "finish", Qt::QueuedConnection);
+        return;
+    }
+
+    QDir::Filters filters;
+    if (m_operation == CopyTree) {
+        filters = QDir::NoDotAndDotDot | QDir::AllDirs | QDir::Files | QDir::NoSymLinks | QDir::Drives;
+        if (!QDir().mkpath(m_destination)) {
+            fail("Unable to create directory '" + m_destination + "'");
+        }
+    } else {
+        filters = QDir::NoDotAndDotDot | QDir::System | QDir::Hidden | QDir::AllDirs | QDir::Files;
+    }
+
+    // Copies only need paths relative to the source; removals use the full paths
+    QDirIterator it(m_source, filters, QDirIterator::Subdirectories);
+    while (it.hasNext() && !m_cancelled.load()) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        if (info.isDir() && !info.isSymLink()) {
+            if (m_operation == RemoveTree) {
+                m_directories.append(info.filePath());
+            } else if (!QDir().mkpath(m_destination + "/" + root.relativeFilePath(info.filePath()))) {
+                fail("Unable to create directory '" + m_destination + "/" + root.relativeFilePath(info.filePath()) + "'");
+            }
+        } else {
+            m_files.append(m_operation == CopyTree ? root.relativeFilePath(info.filePath()) : info.filePath());
+        }
+    }
+
+    if (m_cancelled.load()) {
+        QMetaObject::invokeMethod(this, "finish", Qt::QueuedConnection);
+        return;
+    }
+
+    QMetaObject::invokeMethod(this, "reportProgress", Qt::QueuedConnection, Q_ARG(int, 0));
+
+    // NOTE: the job may be finished, and deleted, as soon as the last task is started
+    const int tasks = qBound(1, m_files.size(), QThreadPool::globalInstance()->maxThreadCount());
+    m_running.store(tasks);
+    for (int i = 0; i < tasks; ++i) {
+        QThreadPool::globalInstance()->start(new TreeJobTask(this, false));
+    }
+}
+
+void TreeJob::processFiles()
+{
+    const int total = m_files.size();
+    while (!m_cancelled.load()) {
+        const int index = m_next.fetchAndAddRelaxed(1);
+        if (index >= total || !processFile(index)) {
+            break;
+        }
+        const int done = m_done.fetchAndAddRelaxed(1) + 1;
+        if (done % TREE_JOB_PROGRESS_INTERVAL == 0 || done == total) {
+            QMetaObject::invokeMethod(this, "reportProgress", Qt::QueuedConnection, Q_ARG(int, done));
+        }
+    }
+
+    if (!m_running.deref()) {
+        // Last task out: all the files are done, the directories can go
+        if (m_operation == RemoveTree && !m_cancelled.load()) {
+            QStringList directories = m_directories;
+            directories.prepend(m_source);
+            // QDirIterator lists a directory before its content: going backwards removes the deepest first
+            for (int i = directories.size() - 1; i >= 0; --i) {
+                if (!QDir().rmdir(directories.at(i))) {
+                    fail("Unable to remove directory '" + directories.at(i) + "'");
+                    break;
+                }
+            }
+        }
+        QMetaObject::invokeMethod(this, "finish", Qt::QueuedConnection);
+    }
+}
+
+// public slots:
+void TreeJob::cancel()
+{
+    m_cancelled.store(1);
+}
+
+// private slots:
+void TreeJob::reportProgress(int done)
+{
+    emit progress(done, m_files.size());
+}
+
+void TreeJob::finish()
+{
+    QString error;
+    {
+        QMutexLocker locker(&m_errorMutex);
+        error = m_error;
+    }
+    if (error.isEmpty() && m_cancelled.load()) {
+        error = "Cancelled";
+    }
+
+    emit finished(error.isEmpty(), error);
+    deleteLater();
+}
+
+// private:
+bool TreeJob::processFile(int index)
+{
+    const QString& file = m_files.at(index);
+    if (m_operation == CopyTree) {
+        const QString source = m_source + "/" + file;
+        const QString destination = m_destination + "/" + file;
+        if (!copyFile(source, destination)) {
+            fail("Unable to copy file '" + source + "' at '" + destination + "'");
+            return false;
+        }
+    } else if (!QFile::remove(file)) {
+        fail("Unable to remove file '" + file + "'");
+        return false;
+    }
+    return true;
+}
+
+void TreeJob::fail(const QString& error)
+{
+    QMutexLocker locker(&m_errorMutex);
+    if (m_error.isEmpty()) {
+        m_error = error;
+    }
+    m_cancelled.store(1);
+}
+
+
+// DirectoryIterator
+// public:
+DirectoryIterator::DirectoryIterator(const QString& path, const QStringList& nameFilters, bool withStat, QObject* parent)
+    : QObject(parent)
+    , m_iterator(path, nameFilters, QDir::NoDotAndDotDot | QDir::AllEntries | QDir::Hidden | QDir::System)
+    , m_withStat(withStat)
+{
+}
+
+// public slots:
+QVariantList DirectoryIterator::next(int count)
+{
+    QVariantList entries;
+    while (entries.size() < count && m_iterator.hasNext()) {
+        m_iterator.next();
+        const QFileInfo info = m_iterator.fileInfo();
+
+        QVariantMap entry;
+        entry["name"] = info.fileName();
+        entry["isDirectory"] = info.isDir();
+        entry["isFile"] = info.isFile();
+        entry["isLink"] = info.isSymLink();
+        if (m_withStat) {
+            // Both come from the same (cached) stat
+            entry["size"] = info.size();
+            entry["lastModified"] = info.lastModified();
+        }
+        entries.append(entry);
+    }
+    return entries;
+}
+
+bool DirectoryIterator::atEnd() const
+{
+    return !m_iterator.hasNext();
+}
+
+void DirectoryIterator::close()
+{
+    deleteLater();
+}
+
+
+// FileWatcher
+// public:
+FileWatcher::FileWatcher(QObject* parent)
+    : QObject(parent)
+    , m_watcher(new QFileSystemWatcher(this))
+{
+    connect(m_watcher, SIGNAL(fileChanged(QString)), this, SLOT(handleFileChanged(QString)));
+    connect(m_watcher, SIGNAL(directoryChanged(QString)), this, SLOT(handleDirectoryChanged(QString)));
+}
+
+// public slots:
+bool FileWatcher::add(const QString& path)
+{
+    if (!m_watcher->addPath(path)) {
+        qDebug() << "FileWatcher::add - " << "Couldn't watch:" << path;
+        return false;
+    }
+    if (QFileInfo(path).isDir()) {
+        // Remember the current entries, to tell what changed later on
+        m_entries[path] = QDir(path).entryList(QDir::NoDotAndDotDot | QDir::AllEntries | QDir::Hidden | QDir::System).toSet();
+    }
+    return true;
+}
+
+void FileWatcher::remove(const QString& path)
+{
+    m_watcher->removePath(path);
+    m_entries.remove(path);
+}
+
+QStringList FileWatcher::paths() const
+{
+    return m_watcher->files() + m_watcher->directories();
+}
+
+void FileWatcher::close()
+{
+    deleteLater();
+}
+
+// private slots:
+void FileWatcher::handleFileChanged(const QString& path)
+{
+    const bool exists = QFile::exists(path);
+    if (exists && !m_watcher->files().contains(path)) {
+        // Replaced by a rename, which drops the old file from the watcher
+        m_watcher->addPath(path);
+    }
+    emit fileChanged(path, exists);
+}
+
+void FileWatcher::handleDirectoryChanged(const QString& path)
+{
+    if (!QFileInfo(path).isDir()) {
+        m_entries.remove(path);
+        emit fileChanged(path, false);
+        return;
+    }
+
+    const QSet<QString> entries = QDir(path).entryList(QDir::NoDotAndDotDot | QDir::AllEntries | QDir::Hidden | QDir::System).toSet();
+    const QSet<QString> previousEntries = m_entries.value(path);
+    m_entries[path] = entries;
+
+    QStringList added = (entries - previousEntries).toList();
+    QStringList removed = (previousEntries - entries).toList();
+    if (added.isEmpty() && removed.isEmpty()) {
+        // An entry was modified in place: that is reported for watched files only
+        return;
+    }
+    added.sort();
+    removed.sort();
+    emit directoryChanged(path, added, removed);
+}
+
 
 // FileSystem
 // public:
@@ -301,6 +797,17 @@ QString FileSystem::readLink(const QString& path) const
     return QFileInfo(path).symLinkTarget();
 }
 
+// Watching
+QObject* FileSystem::_watch(const QString& path) const
+{
+    FileWatcher* watcher = new FileWatcher();
+    if (!watcher->add(path)) {
+        delete watcher;
+        return 0;
+    }
+    return watcher;
+}
+
 // Tests
 bool FileSystem::exists(const QString& path) const
 {
@@ -372,6 +879,13 @@ bool FileSystem::_copyTree(const QString& source, const QString& destination) co
     return true;
 }
 
+QObject* FileSystem::_copyTreeAsync(const QString& source, const QString& destination) const
+{
+    TreeJob* job = new TreeJob(TreeJob::CopyTree, source, destination);
+    job->start();
+    return job;
+}
+
 bool FileSystem::makeDirectory(const QString& path) const
 {
     return QDir().mkdir(path);
@@ -412,11 +926,31 @@ bool FileSystem::_removeTree(const QString& path) const
     return true;
 }
 
+QObject* FileSystem::_removeTreeAsync(const QString& path) const
+{
+    TreeJob* job = new TreeJob(TreeJob::RemoveTree, path);
+    job->start();
+    return job;
+}
+
 QStringList FileSystem::list(const QString& path) const
 {
     return QDir(path).entryList();
 }
 
+QObject* FileSystem::_openDirectory(const QString& path, const QVariantMap& opts) const
+{
+    if (!QFileInfo(path).isDir()) {
+        qDebug() << "FileSystem::openDirectory - " << "Not a directory:" << path;
+        return 0;
+    }
+
+    // "filter" is a wildcard pattern, or a list of them (e.g. "*.png")
+    const QStringList nameFilters = opts.value("filter").toStringList();
+    const bool withStat = opts.value("stat", true).toBool();
+    return new DirectoryIterator(path, nameFilters, withStat);
+}
+
 // Paths
 QString FileSystem::separator() const
 {
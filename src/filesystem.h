@@ -30,6 +30,11 @@
 #ifndef FILESYSTEM_H
 #define FILESYSTEM_H
 
+#include <QAtomicInt>
+#include <QDirIterator>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
 #include <QStringList>
 #include <QFile>
 #include <QTextCodec>
@@ -55,6 +60,23 @@ public slots:
     QString read(const QVariant& n = -1);
     bool write(const QString& data);
 
+    /**
+     * Binary-safe counterpart of "read()": the bytes reach JavaScript as a
+     * Uint8ClampedArray, with no conversion to a string.
+     * Reading the whole file maps it in memory instead of reading it.
+     * @param n Number of bytes to read (a negative value means the whole file);
+     * text files can only be read whole
+     */
+    QByteArray readBytes(const QVariant& n = -1);
+    /// Write raw bytes (e.g. a Uint8ClampedArray), whatever the file encoding
+    bool writeBytes(const QByteArray& data);
+    /**
+     * Write several chunks (strings, or byte arrays written as is) at once.
+     * Binary files get a single write; unbuffered files (e.g. "system.stdout")
+     * are flushed once for the whole batch.
+     */
+    bool writeBatch(const QVariantList& chunks);
+
     bool seek(const qint64 pos);
 
     QString readLine();
@@ -69,9 +91,143 @@ public slots:
 
 private:
     bool _isUnbuffered() const;
+    void _unmap();
 
     QFile* m_file;
     QTextStream* m_fileStream;
+    uchar* m_mapped;
+    qint64 m_mappedSize;
+};
+
+
+/**
+ * Copies or removes a directory tree on QThreadPool::globalInstance().
+ *
+ * One task walks the tree (creating the destination directories when
+ * copying), then the files are shared out between as many tasks as the
+ * pool has threads. Progress and completion are reported on the thread
+ * the job lives in.
+ */
+class TreeJob : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Operation {
+        CopyTree,
+        RemoveTree
+    };
+
+    TreeJob(Operation operation, const QString& source, const QString& destination = QString(), QObject* parent = 0);
+
+    void start();
+
+    // Called by the pool tasks
+    void scan();
+    void processFiles();
+
+public slots:
+    /// Stop as soon as the files being processed are done; "finished" reports a failure
+    void cancel();
+
+signals:
+    /// @p done files out of @p total have been copied/removed
+    void progress(int done, int total);
+    /// @p error is empty on success
+    void finished(bool success, const QString& error);
+
+private slots:
+    void reportProgress(int done);
+    void finish();
+
+private:
+    bool processFile(int index);
+    void fail(const QString& error);
+
+    Operation m_operation;
+    QString m_source;
+    QString m_destination;
+
+    // Filled in by "scan()", read-only afterwards
+    QStringList m_files;
+    QStringList m_directories;
+
+    QAtomicInt m_next;
+    QAtomicInt m_done;
+    QAtomicInt m_running;
+    QAtomicInt m_cancelled;
+    QMutex m_errorMutex;
+    QString m_error;
+};
+
+
+/**
+ * Walks the entries of a directory a batch at a time.
+ *
+ * Each entry comes with its type, read along with the name where the
+ * platform allows it (d_type on Linux), and, unless turned off, its size and
+ * modification date from a single stat: there is no need to call
+ * "isDirectory()", "size()" and "lastModified()" on every name.
+ */
+class DirectoryIterator : public QObject
+{
+    Q_OBJECT
+
+public:
+    DirectoryIterator(const QString& path, const QStringList& nameFilters, bool withStat, QObject* parent = 0);
+
+public slots:
+    /**
+     * Return up to @p count entries, as maps with "name", "isDirectory", "isFile",
+     * "isLink" and (with stat info) "size" and "lastModified".
+     * An empty list means all the entries were returned.
+     */
+    QVariantList next(int count = 1000);
+    bool atEnd() const;
+    void close();
+
+private:
+    QDirIterator m_iterator;
+    bool m_withStat;
+};
+
+
+class QFileSystemWatcher;
+
+/**
+ * Reports changes to files and directories, through QFileSystemWatcher
+ * (inotify on Linux): nothing runs until something changes.
+ *
+ * For directories, the entries are compared with the previous listing, so
+ * the signal says which names were added and removed.
+ */
+class FileWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    FileWatcher(QObject* parent = 0);
+
+public slots:
+    /// Start watching @p path (a file or a directory)
+    bool add(const QString& path);
+    void remove(const QString& path);
+    QStringList paths() const;
+    void close();
+
+signals:
+    /// @p path was modified, or removed if @p exists is false
+    void fileChanged(const QString& path, bool exists);
+    /// Entries were @p added to or @p removed from the directory @p path
+    void directoryChanged(const QString& path, const QStringList& added, const QStringList& removed);
+
+private slots:
+    void handleFileChanged(const QString& path);
+    void handleDirectoryChanged(const QString& path);
+
+private:
+    QFileSystemWatcher* m_watcher;
+    QHash<QString, QSet<QString> > m_entries;
 };
 
 
@@ -93,12 +249,16 @@ public slots:
     // Directory
     // 'copyTree(source, destination)' implemented in "filesystem-shim.js" using '_copyTree(source, destination)'
     bool _copyTree(const QString& source, const QString& destination) const;
+    // 'copyTreeAsync(source, destination, callback, onProgress)' implemented in "filesystem-shim.js" using '_copyTreeAsync(source, destination)'
+    QObject* _copyTreeAsync(const QString& source, const QString& destination) const;
     bool makeDirectory(const QString& path) const;
     bool makeTree(const QString& path) const;
     // 'removeDirectory(path)' implemented in "filesystem-shim.js" using '_removeDirectory(path)'
     bool _removeDirectory(const QString& path) const;
     // 'removeTree(path)' implemented in "filesystem-shim.js" using '_removeTree(path)'
     bool _removeTree(const QString& path) const;
+    // 'removeTreeAsync(path, callback, onProgress)' implemented in "filesystem-shim.js" using '_removeTreeAsync(path)'
+    QObject* _removeTreeAsync(const QString& path) const;
 
     // Files
     // 'open(path, mode|options)' implemented in "filesystem-shim.js" using '_open(path, opts)'
@@ -116,6 +276,8 @@ public slots:
 
     // Listing
     QStringList list(const QString& path) const;
+    // 'openDirectory(path, options)' implemented in "filesystem-shim.js" using '_openDirectory(path, options)'
+    QObject* _openDirectory(const QString& path, const QVariantMap& opts) const;
 
     // Paths
     QString separator() const;
@@ -130,6 +292,10 @@ public slots:
     // Links
     QString readLink(const QString& path) const;
 
+    // Watching
+    // 'watch(path, callback)' implemented in "filesystem-shim.js" using '_watch(path)'
+    QObject* _watch(const QString& path) const;
+
     // Tests
     bool exists(const QString& path) const;
     bool isDirectory(const QString& path) const;
@@ -0,0 +1,245 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "hostresolver.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QHostInfo>
+#include <QStringList>
+
+// Upper bound on the number of cached hosts; expired entries are dropped first.
+#define HOST_RESOLVER_MAX_CACHE_ENTRIES 1024
+
+static HostResolver* hostresolver_instance = 0;
+
+HostResolver* HostResolver::instance()
+{
+    if (!hostresolver_instance) {
+        hostresolver_instance = new HostResolver();
+    }
+
+    return hostresolver_instance;
+}
+
+HostResolver::HostResolver()
+    : QObject(QCoreApplication::instance())
+    , m_cacheTtl(0)
+    , m_lookups(0)
+    , m_hits(0)
+    , m_misses(0)
+    , m_mapped(0)
+    , m_resolved(0)
+    , m_failures(0)
+{
+}
+
+QString HostResolver::rules() const
+{
+    return m_rulesString;
+}
+
+bool HostResolver::setRules(const QString& rules)
+{
+    QList<Rule> parsed;
+
+    foreach(const QString & ruleString, rules.split(',', QString::SkipEmptyParts)) {
+        QStringList parts = ruleString.trimmed().split(QRegExp("\\s+"), QString::SkipEmptyParts);
+        if (parts.isEmpty()) {
+            continue;
+        }
+
+        Rule rule;
+        rule.port = -1;
+        const QString type = parts.at(0).toUpper();
+        if (type == "MAP" && parts.size() == 3) {
+            // Parse "host", "host:port" and "[v6address]:port" alike
+            QUrl target(QLatin1String("//") + parts.at(2));
+            if (!target.isValid() || target.host().isEmpty()) {
+                qWarning() << "HostResolver - Invalid mapping target:" << parts.at(2);
+                return false;
+            }
+            rule.exclude = false;
+            rule.host = target.host();
+            rule.port = target.port(-1);
+        } else if (type == "EXCLUDE" && parts.size() == 2) {
+            rule.exclude = true;
+        } else {
+            qWarning() << "HostResolver - Invalid rule:" << ruleString.trimmed();
+            return false;
+        }
+        rule.pattern = QRegExp(parts.at(1), Qt::CaseInsensitive, QRegExp::Wildcard);
+        parsed.append(rule);
+    }
+
+    m_rules = parsed;
+    m_rulesString = rules;
+    return true;
+}
+
+int HostResolver::cacheTtl() const
+{
+    return m_cacheTtl;
+}
+
+void HostResolver::setCacheTtl(int seconds)
+{
+    m_cacheTtl = qMax(0, seconds);
+    if (m_cacheTtl == 0) {
+        clearCache();
+    }
+}
+
+QUrl HostResolver::resolve(const QUrl& url, bool useCache)
+{
+    const QString scheme = url.scheme().toLower();
+    if (scheme != QLatin1String("http") && scheme != QLatin1String("https")) {
+        return url;
+    }
+
+    const QString host = url.host().toLower();
+    if (host.isEmpty()) {
+        return url;
+    }
+
+    if (!m_rules.isEmpty()) {
+        const Rule* rule = findRule(host);
+        if (rule) {
+            QUrl mapped(url);
+            mapped.setHost(rule->host);
+            if (rule->port != -1) {
+                mapped.setPort(rule->port);
+            }
+            ++m_mapped;
+            return mapped;
+        }
+    }
+
+    // Only plain HTTP can be sent to a literal address: HTTPS needs
+    // the host name for SNI and for the certificate verification.
+    if (!useCache || m_cacheTtl <= 0 || scheme != QLatin1String("http") || !QHostAddress(host).isNull()) {
+        return url;
+    }
+
+    ++m_lookups;
+    QHash<QString, CacheEntry>::const_iterator entry = m_cache.constFind(host);
+    if (entry != m_cache.constEnd() && entry->expiresAt > QDateTime::currentMSecsSinceEpoch()) {
+        ++m_hits;
+        QUrl resolved(url);
+        resolved.setHost(entry->address.toString());
+        return resolved;
+    }
+
+    // Let Qt resolve this one as usual, and refresh the cache for the next requests
+    ++m_misses;
+    lookup(host);
+    return url;
+}
+
+QVariantMap HostResolver::stats() const
+{
+    QVariantMap result;
+    result["lookups"] = m_lookups;
+    result["hits"] = m_hits;
+    result["misses"] = m_misses;
+    result["hitRate"] = m_lookups > 0 ? qreal(m_hits) / m_lookups : 0.0;
+    result["mapped"] = m_mapped;
+    result["resolved"] = m_resolved;
+    result["failures"] = m_failures;
+    result["entries"] = m_cache.size();
+    result["pending"] = m_pendingLookups.size();
+    return result;
+}
+
+void HostResolver::clearCache()
+{
+    m_cache.clear();
+}
+
+// private slots:
+void HostResolver::handleLookedUp(const QHostInfo& info)
+{
+    const QString host = info.hostName().toLower();
+    m_pendingLookups.remove(host);
+
+    if (info.error() != QHostInfo::NoError || info.addresses().isEmpty()) {
+        qDebug() << "HostResolver - Lookup failed:" << host << info.errorString();
+        ++m_failures;
+        m_cache.remove(host);
+        return;
+    }
+
+    ++m_resolved;
+    if (m_cacheTtl <= 0) {
+        return;
+    }
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (m_cache.size() >= HOST_RESOLVER_MAX_CACHE_ENTRIES) {
+        QMutableHashIterator<QString, CacheEntry> i(m_cache);
+        while (i.hasNext()) {
+            if (i.next().value().expiresAt <= now) {
+                i.remove();
+            }
+        }
+        if (m_cache.size() >= HOST_RESOLVER_MAX_CACHE_ENTRIES) {
+            m_cache.clear();
+        }
+    }
+
+    CacheEntry entry;
+    entry.address = info.addresses().first();
+    entry.expiresAt = now + qint64(m_cacheTtl) * 1000;
+    m_cache.insert(host, entry);
+}
+
+// private:
+const HostResolver::Rule* HostResolver::findRule(const QString& host) const
+{
+    // Exclusions win over any mapping, regardless of their position
+    foreach(const Rule & rule, m_rules) {
+        if (rule.exclude && rule.pattern.exactMatch(host)) {
+            return 0;
+        }
+    }
+    for (int i = 0; i < m_rules.size(); ++i) {
+        if (!m_rules.at(i).exclude && m_rules.at(i).pattern.exactMatch(host)) {
+            return &m_rules.at(i);
+        }
+    }
+    return 0;
+}
+
+void HostResolver::lookup(const QString& host)
+{
+    if (m_pendingLookups.contains(host)) {
+        return;
+    }
+    m_pendingLookups.insert(host);
+    QHostInfo::lookupHost(host, this, SLOT(handleLookedUp(QHostInfo)));
+}
@@ -0,0 +1,120 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef HOSTRESOLVER_H
+#define HOSTRESOLVER_H
+
+#include <QHash>
+#include <QHostAddress>
+#include <QList>
+#include <QObject>
+#include <QRegExp>
+#include <QSet>
+#include <QUrl>
+#include <QVariantMap>
+
+class QHostInfo;
+
+/**
+ * Process-wide host name resolution shared by every NetworkAccessManager.
+ *
+ * It does two things:
+ *  - applies "--host-resolver-rules" (e.g. "MAP *.example.com 127.0.0.1:8080,
+ *    EXCLUDE www.example.com"), so hosts can be pointed at a local server
+ *    without touching /etc/hosts;
+ *  - when "--dns-cache-ttl" is greater than zero, caches lookups for plain
+ *    HTTP hosts, so requests to an already resolved host skip the system resolver.
+ *
+ * Resolution only rewrites the URL the request is sent to: callers are
+ * responsible for keeping the original URL visible to WebKit (see
+ * NetworkReplyProxy). A cached address replaces the host in that URL, so
+ * callers skip the cache when the URL is used for more than connecting,
+ * e.g. as a disk cache key or as the absolute URI sent to a proxy.
+ */
+class HostResolver : public QObject
+{
+    Q_OBJECT
+
+public:
+    static HostResolver* instance();
+
+    QString rules() const;
+    /// @return false if @p rules could not be parsed (no rule is applied in that case)
+    bool setRules(const QString& rules);
+
+    int cacheTtl() const;
+    /// @p seconds Time a resolved address is reused; 0 disables the cache
+    void setCacheTtl(int seconds);
+
+    /**
+     * Return the URL the request for @p url should actually be sent to.
+     * If no rule applies and no cached address is available (or @p useCache
+     * is false), @p url is returned unchanged.
+     */
+    QUrl resolve(const QUrl& url, bool useCache = true);
+
+    /// Lookup counters, used to tune the cache TTL
+    QVariantMap stats() const;
+
+    void clearCache();
+
+private slots:
+    void handleLookedUp(const QHostInfo& info);
+
+private:
+    HostResolver();
+
+    struct Rule {
+        bool exclude;
+        QRegExp pattern;
+        QString host;
+        int port;
+    };
+
+    struct CacheEntry {
+        QHostAddress address;
+        qint64 expiresAt;
+    };
+
+    const Rule* findRule(const QString& host) const;
+    void lookup(const QString& host);
+
+    QList<Rule> m_rules;
+    QString m_rulesString;
+    int m_cacheTtl;
+    QHash<QString, CacheEntry> m_cache;
+    QSet<QString> m_pendingLookups;
+
+    qint64 m_lookups;
+    qint64 m_hits;
+    qint64 m_misses;
+    qint64 m_mapped;
+    qint64 m_resolved;
+    qint64 m_failures;
+};
+
+#endif // HOSTRESOLVER_H
@@ -113,6 +113,22 @@ exports.read = function (path, modeOrOpts) {
     return content;
 };
 
+/** Open and read the content of a file as raw bytes.
+ * Large files are mapped in memory rather than read, and their content is
+ * not converted to a string.
+ * It will throw an exception if it fails.
+ *
+ * @param path Path of the file to read from
+ * @return file content, as a Uint8ClampedArray
+ */
+exports.readBytes = function (path) {
+    var f = exports.open(path, 'rb'),
+        content = f.readBytes();
+
+    f.close();
+    return content;
+};
+
 /** Open and write text content to a file
  * It will throw an exception if it fails.
  *
@@ -138,6 +154,23 @@ exports.write = function (path, content, modeOrOpts) {
     f.close();
 };
 
+/** Open and write raw bytes to a file.
+ * It will throw an exception if it fails.
+ *
+ * @param path Path of the file to write to
+ * @param content Bytes to write (e.g. a Uint8ClampedArray)
+ * @param mode Open Mode: 'w' (default) or 'a'
+ */
+exports.writeBytes = function (path, content, mode) {
+    var f = exports.open(path, (mode || 'w') + 'b');
+
+    if (!f.writeBytes(content)) {
+        f.close();
+        throw "Unable to write file '" + path + "'";
+    }
+    f.close();
+};
+
 /** Return the size of a file, in bytes.
  * It will throw an exception if it fails.
  *
@@ -220,6 +253,90 @@ exports.removeTree = function (path) {
     }
 };
 
+/** Open a directory to walk its entries a batch at a time.
+ * It will throw an exception if it fails.
+ *
+ * @param path Path of the directory
+ * @param opts Options.
+ *          - filter A wildcard pattern (e.g. "*.png"), or a list of them
+ *          - stat false to leave out "size" and "lastModified", which need a stat per entry
+ * @return directory object: "next(count)" returns the next entries (an empty
+ *         array at the end), "close()" releases it
+ */
+exports.openDirectory = function (path, opts) {
+    var dir = exports._openDirectory(path, opts || {});
+    if (dir) {
+        return dir;
+    }
+    throw "Unable to open directory '" + path + "'";
+};
+
+/** Watch a file or a directory for changes.
+ * It will throw an exception if it fails.
+ *
+ * @param path Path of the file or directory to watch
+ * @param callback Called with the kind of change and the path it happened to:
+ *          - 'changed' a watched file was modified
+ *          - 'removed' a watched file or directory, or an entry of a watched directory, is gone
+ *          - 'added' an entry was added to a watched directory
+ * @return watcher object: "add(path)" watches more paths, "close()" stops watching
+ */
+exports.watch = function (path, callback) {
+    var watcher = exports._watch(path);
+    if (!watcher) {
+        throw "Unable to watch '" + path + "'";
+    }
+
+    watcher.fileChanged.connect(function (changedPath, exists) {
+        callback(exists ? 'changed' : 'removed', changedPath);
+    });
+    watcher.directoryChanged.connect(function (directory, added, removed) {
+        added.forEach(function (name) {
+            callback('added', exports.join(directory, name));
+        });
+        removed.forEach(function (name) {
+            callback('removed', exports.join(directory, name));
+        });
+    });
+    return watcher;
+};
+
+/** Hook a background tree job up to its callbacks */
+function startTreeJob(job, callback, onProgress) {
+    job.finished.connect(function (success, error) {
+        if (typeof callback === 'function') {
+            callback(success ? null : error);
+        }
+    });
+    if (typeof onProgress === 'function') {
+        job.progress.connect(onProgress);
+    }
+    return job;
+}
+
+/** Copy a directory tree in the background, copying files in parallel.
+ *
+ * @param source Path of the source directory tree
+ * @param destination Path of the destination directory tree
+ * @param callback Called with null once done, or with an error message
+ * @param onProgress Optional, called with the number of files copied so far and the total
+ * @return job object: call its cancel() to stop the copy
+ */
+exports.copyTreeAsync = function (source, destination, callback, onProgress) {
+    return startTreeJob(exports._copyTreeAsync(source, destination), callback, onProgress);
+};
+
+/** Remove a directory tree in the background, removing files in parallel.
+ *
+ * @param path Path of the directory tree to remove
+ * @param callback Called with null once done, or with an error message
+ * @param onProgress Optional, called with the number of files removed so far and the total
+ * @return job object: call its cancel() to stop the removal
+ */
+exports.removeTreeAsync = function (path, callback, onProgress) {
+    return startTreeJob(exports._removeTreeAsync(path), callback, onProgress);
+};
+
 exports.touch = function (path) {
     exports.write(path, "", 'a');
 };
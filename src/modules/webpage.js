@@ -266,6 +266,12 @@ function decorateNewPage(opts, page) {
 
     definePageSignalHandler(page, handlers, "onClosing", "closing");
 
+    definePageSignalHandler(page, handlers, "onDownloadStarted", "downloadStarted");
+
+    definePageSignalHandler(page, handlers, "onDownloadProgress", "downloadProgress");
+
+    definePageSignalHandler(page, handlers, "onDownloadFinished", "downloadFinished");
+
     // Private callback for "page.open()"
     definePageSignalHandler(page, handlers, "_onPageOpenFinished", "loadFinished");
 
@@ -94,7 +94,7 @@ exports.create = function (opts) {
         return target;
     }
 
-    function defineSetter(handlerName, signalName) {
+    function defineSetter(handlerName, signalName, wrap) {
         Object.defineProperty(server, handlerName, {
             set: function (f) {
                 if (handlers && typeof handlers[signalName] === 'function') {
@@ -102,13 +102,59 @@ exports.create = function (opts) {
                         this[signalName].disconnect(handlers[signalName]);
                     } catch (e) {}
                 }
-                handlers[signalName] = f;
+                handlers[signalName] = wrap ? wrap(f) : f;
                 this[signalName].connect(handlers[signalName]);
             }
         });
     }
 
-    defineSetter("onNewRequest", "newRequest");
+    function defineResponseSetter(response, handlerName, signalName) {
+        var handler;
+        Object.defineProperty(response, handlerName, {
+            set: function (f) {
+                if (typeof handler === 'function') {
+                    try {
+                        response[signalName].disconnect(handler);
+                    } catch (e) {}
+                }
+                handler = f;
+                if (typeof f === 'function') {
+                    response[signalName].connect(f);
+                }
+            },
+            get: function () {
+                return handler;
+            }
+        });
+    }
+
+    // "request.header(name)" looks up request headers case-insensitively,
+    // the index it needs is only built on first use
+    function defineHeaderLookup(request) {
+        var index;
+        Object.defineProperty(request, "header", {
+            value: function (name) {
+                if (!index) {
+                    index = {};
+                    Object.keys(request.headers || {}).forEach(function (key) {
+                        index[key.toLowerCase()] = request.headers[key];
+                    });
+                }
+                return index[String(name).toLowerCase()];
+            }
+        });
+    }
+
+    // Event streams and WebSockets report the client's messages and
+    // disconnection through "response.onMessage" and "response.onClose"
+    defineSetter("onNewRequest", "newRequest", function (f) {
+        return function (request, response) {
+            defineHeaderLookup(request);
+            defineResponseSetter(response, "onMessage", "message");
+            defineResponseSetter(response, "onClose", "closed");
+            return f.call(this, request, response);
+        };
+    });
 
     server.listen = function (port, arg1, arg2) {
         if (arguments.length === 2 && typeof arg1 === 'function') {
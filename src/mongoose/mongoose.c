@@ -187,6 +187,10 @@ typedef struct DIR {
 #include <dlfcn.h>
 #endif
 #include <pthread.h>
+#if defined(__linux__) && !defined(NO_SENDFILE)
+#include <sys/sendfile.h>
+#define HAVE_SENDFILE
+#endif
 #if defined(__MACH__)
 #define SSL_LIB   "libssl.dylib"
 #define CRYPTO_LIB  "libcrypto.dylib"
@@ -398,8 +402,8 @@ struct socket {
 enum {
   CGI_EXTENSIONS, CGI_ENVIRONMENT, PUT_DELETE_PASSWORDS_FILE, CGI_INTERPRETER,
   PROTECT_URI, AUTHENTICATION_DOMAIN, SSI_EXTENSIONS, ACCESS_LOG_FILE,
-  SSL_CHAIN_FILE, ENABLE_DIRECTORY_LISTING, ERROR_LOG_FILE,
-  GLOBAL_PASSWORDS_FILE, INDEX_FILES,
+  LISTEN_BACKLOG, SSL_CHAIN_FILE, ENABLE_DIRECTORY_LISTING, ERROR_LOG_FILE,
+  GLOBAL_PASSWORDS_FILE, INDEX_FILES, KEEP_ALIVE_TIMEOUT,
   ENABLE_KEEP_ALIVE, ACCESS_CONTROL_LIST, MAX_REQUEST_SIZE,
   EXTRA_MIME_TYPES, LISTENING_PORTS,
   DOCUMENT_ROOT, SSL_CERTIFICATE, NUM_THREADS, RUN_AS_USER,
@@ -415,11 +419,13 @@ static const char *config_options[] = {
   "R", "authentication_domain", "mydomain.com",
   "S", "ssi_extensions", ".shtml,.shtm",
   "a", "access_log_file", NULL,
+  "b", "listen_backlog", "20",
   "c", "ssl_chain_file", NULL,
   "d", "enable_directory_listing", "yes",
   "e", "error_log_file", NULL,
   "g", "global_passwords_file", NULL,
   "i", "index_files", "index.html,index.htm,index.cgi",
+  "K", "keep_alive_timeout_ms", "0",
   "k", "enable_keep_alive", "no",
   "l", "access_control_list", NULL,
   "M", "max_request_size", "16384",
@@ -467,6 +473,7 @@ struct mg_connection {
   int buf_size;               // Buffer size
   int request_len;            // Size of the request + headers in a buffer
   int data_len;               // Total size of data in a buffer
+  int detached;               // Socket handed over by mg_detach()
 };
 
 const char **mg_get_valid_option_names(void) {
@@ -1417,6 +1424,31 @@ int mg_read(struct mg_connection *conn, void *buf, size_t len) {
   return nread;
 }
 
+int mg_read_some(struct mg_connection *conn, void *buf, size_t len) {
+  int buffered_len;
+
+  // Data read in together with the request headers comes first
+  buffered_len = conn->data_len - conn->request_len - (int) conn->consumed_content;
+  if (buffered_len > 0) {
+    if (len > (size_t) buffered_len) {
+      len = (size_t) buffered_len;
+    }
+    memcpy(buf, conn->buf + conn->request_len + conn->consumed_content, len);
+    conn->consumed_content += len;
+    return (int) len;
+  }
+
+  buffered_len = pull(NULL, conn->client.sock, conn->ssl, (char *) buf, (int) len);
+  if (buffered_len > 0) {
+    conn->consumed_content += buffered_len;
+  }
+  return buffered_len;
+}
+
+long long mg_get_socket(const struct mg_connection *conn) {
+  return (long long) conn->client.sock;
+}
+
 int mg_write(struct mg_connection *conn, const void *buf, size_t len) {
   return (int) push(NULL, conn->client.sock, conn->ssl,
       (const char *) buf, (int64_t) len);
@@ -2483,6 +2515,38 @@ static void send_file_data(struct mg_connection *conn, FILE *fp, int64_t len) {
   char buf[BUFSIZ];
   int to_read, num_read, num_written;
 
+#if defined(HAVE_SENDFILE)
+  // Let the kernel copy regular files straight into plain sockets. Pipes
+  // (CGI output) make sendfile() fail with EINVAL before anything is sent,
+  // and are copied through the buffer below instead.
+  if (conn->ssl == NULL) {
+    off_t offset = ftello(fp);
+    ssize_t n;
+    int64_t sent = 0;
+    int error = 0;
+
+    while (len > 0) {
+      n = sendfile(conn->client.sock, fileno(fp), &offset,
+                   len > INT_MAX ? INT_MAX : (size_t) len);
+      if (n < 0 && ERRNO == EINTR) {
+        continue;
+      } else if (n < 0) {
+        error = ERRNO;
+        break;
+      } else if (n == 0) {
+        break;
+      }
+      sent += n;
+      conn->num_bytes_sent += n;
+      len -= n;
+    }
+    // Only fall back to read/write when sendfile() itself is unsupported
+    if (sent > 0 || len == 0 || (error != EINVAL && error != ENOSYS)) {
+      return;
+    }
+  }
+#endif
+
   while (len > 0) {
     // Calculate how much to read from the file in the buffer
     to_read = sizeof(buf);
@@ -2507,6 +2571,12 @@ static int parse_range_header(const char *header, int64_t *a, int64_t *b) {
   return sscanf(header, "bytes=%" INT64_FMT "-%" INT64_FMT, a, b);
 }
 
+static void construct_etag(char *buf, size_t buf_len,
+                           const struct mgstat *stp) {
+  (void) snprintf(buf, buf_len, "\"%lx.%lx\"",
+      (unsigned long) stp->mtime, (unsigned long) stp->size);
+}
+
 static void handle_file_request(struct mg_connection *conn, const char *path,
                                 struct mgstat *stp) {
   char date[64], lm[64], etag[64], range[64];
@@ -2533,6 +2603,25 @@ static void handle_file_request(struct mg_connection *conn, const char *path,
   r1 = r2 = 0;
   hdr = mg_get_header(conn, "Range");
   if (hdr != NULL && (n = parse_range_header(hdr, &r1, &r2)) > 0) {
+    // "bytes=-N" is parsed as a negative start: it asks for the last N bytes.
+    // An empty suffix ("bytes=-0") is unsatisfiable, as required by RFC 7233.
+    if (n == 1 && strncmp(hdr, "bytes=-", 7) == 0) {
+      r1 = r1 == 0 ? stp->size : -r1 > stp->size ? 0 : stp->size + r1;
+    }
+    if (r1 < 0 || r1 >= stp->size || (n == 2 && r2 < r1)) {
+      (void) fclose(fp);
+      conn->request_info.status_code = 416;
+      (void) mg_printf(conn,
+          "HTTP/1.1 416 Requested Range Not Satisfiable\r\n"
+          "Content-Range: bytes */%" INT64_FMT "\r\n"
+          "Content-Length: 0\r\n"
+          "Connection: %s\r\n\r\n",
+          stp->size, suggest_connection_header(conn));
+      return;
+    }
+    if (n == 2 && r2 >= stp->size) {
+      r2 = stp->size - 1;
+    }
     conn->request_info.status_code = 206;
     (void) fseeko(fp, (off_t) r1, SEEK_SET);
     cl = n == 2 ? r2 - r1 + 1: cl - r1;
@@ -2547,14 +2636,13 @@ static void handle_file_request(struct mg_connection *conn, const char *path,
   // Prepare Etag, Date, Last-Modified headers
   (void) strftime(date, sizeof(date), fmt, localtime(&curtime));
   (void) strftime(lm, sizeof(lm), fmt, localtime(&stp->mtime));
-  (void) mg_snprintf(conn, etag, sizeof(etag), "%lx.%lx",
-      (unsigned long) stp->mtime, (unsigned long) stp->size);
+  construct_etag(etag, sizeof(etag), stp);
 
   (void) mg_printf(conn,
       "HTTP/1.1 %d %s\r\n"
       "Date: %s\r\n"
       "Last-Modified: %s\r\n"
-      "Etag: \"%s\"\r\n"
+      "Etag: %s\r\n"
       "Content-Type: %.*s\r\n"
       "Content-Length: %" INT64_FMT "\r\n"
       "Connection: %s\r\n"
@@ -2685,7 +2773,15 @@ static int substitute_index_file(struct mg_connection *conn, char *path,
 // Return True if we should reply 304 Not Modified.
 static int is_not_modified(const struct mg_connection *conn,
                            const struct mgstat *stp) {
+  char etag[64];
   const char *ims = mg_get_header(conn, "If-Modified-Since");
+  const char *inm = mg_get_header(conn, "If-None-Match");
+
+  // If-None-Match takes precedence over If-Modified-Since
+  if (inm != NULL) {
+    construct_etag(etag, sizeof(etag), stp);
+    return !strcmp(inm, "*") || strstr(inm, etag) != NULL;
+  }
   return ims != NULL && stp->mtime <= parse_date_string(ims);
 }
 
@@ -3219,6 +3315,35 @@ static void handle_ssi_file_request(struct mg_connection *conn,
   }
 }
 
+// Serve a file or directory from the document root as the response.
+int mg_send_file(struct mg_connection *conn, const char *path) {
+  const char *uri = conn->request_info.uri;
+  char buf[PATH_MAX];
+  struct mgstat st;
+
+  mg_strlcpy(buf, path, sizeof(buf));
+  if (mg_stat(buf, &st) != 0) {
+    send_http_error(conn, 404, "Not Found", "%s", "File not found");
+  } else if (st.is_directory && (uri[0] == '\0' || uri[strlen(uri) - 1] != '/')) {
+    conn->request_info.status_code = 301;
+    (void) mg_printf(conn,
+        "HTTP/1.1 301 Moved Permanently\r\n"
+        "Location: %s/\r\n"
+        "Content-Length: 0\r\n"
+        "Connection: %s\r\n\r\n", uri, suggest_connection_header(conn));
+  } else if (st.is_directory &&
+             !substitute_index_file(conn, buf, sizeof(buf), &st)) {
+    send_http_error(conn, 403, "Directory Listing Denied",
+        "Directory listing denied");
+  } else if (is_not_modified(conn, &st)) {
+    send_http_error(conn, 304, "Not Modified", "");
+  } else {
+    handle_file_request(conn, buf, &st);
+  }
+
+  return conn->request_info.status_code;
+}
+
 // This is the heart of the Mongoose's logic.
 // This function is called when the request is read, parsed and validated,
 // and Mongoose must decide what action to take: serve a file, or
@@ -3357,7 +3482,7 @@ static int set_ports_option(struct mg_context *ctx) {
                           sizeof(reuseaddr)) != 0 ||
 #endif // !_WIN32
                bind(sock, &so.lsa.u.sa, so.lsa.len) != 0 ||
-               listen(sock, 20) != 0) {
+               listen(sock, atoi(ctx->config[LISTEN_BACKLOG])) != 0) {
       closesocket(sock);
       cry(fc(ctx), "%s: cannot bind to %.*s: %s", __func__,
           vec.len, vec.ptr, strerror(ERRNO));
@@ -3788,6 +3913,26 @@ static int is_valid_uri(const char *uri) {
   return (uri[0] == '/' || (uri[0] == '*' && uri[1] == '\0'));
 }
 
+// Wait until the client starts sending a request, for at most
+// keep_alive_timeout_ms (forever if 0). Return 0 on timeout.
+static int wait_for_request(struct mg_connection *conn) {
+  int timeout_ms = atoi(conn->ctx->config[KEEP_ALIVE_TIMEOUT]);
+  struct timeval tv;
+  fd_set read_set;
+  int max_fd = -1;
+
+  if (timeout_ms <= 0 || conn->data_len > 0) {
+    return 1;
+  }
+
+  FD_ZERO(&read_set);
+  add_to_set(conn->client.sock, &read_set, &max_fd);
+  tv.tv_sec = timeout_ms / 1000;
+  tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+  return select(max_fd + 1, &read_set, NULL, NULL, &tv) > 0;
+}
+
 static void process_new_connection(struct mg_connection *conn) {
   struct mg_request_info *ri = &conn->request_info;
   int keep_alive_enabled;
@@ -3800,6 +3945,9 @@ static void process_new_connection(struct mg_connection *conn) {
 
     // If next request is not pipelined, read it in
     if ((conn->request_len = get_request_len(conn->buf, conn->data_len)) == 0) {
+      if (!wait_for_request(conn)) {
+        return;  // Idle for too long
+      }
       conn->request_len = read_request(NULL, conn->client.sock, conn->ssl,
           conn->buf, conn->buf_size, &conn->data_len);
     }
@@ -3837,7 +3985,8 @@ static void process_new_connection(struct mg_connection *conn) {
       discard_current_request_from_buffer(conn);
     }
     // conn->peer is not NULL only for SSL-ed proxy connections
-  } while (conn->peer || (keep_alive_enabled && should_keep_alive(conn)));
+  } while (!conn->detached &&
+           (conn->peer || (keep_alive_enabled && should_keep_alive(conn))));
 }
 
 // Worker threads take accepted socket from the queue
@@ -3886,6 +4035,7 @@ static void worker_thread(struct mg_context *ctx) {
   while (ctx->stop_flag == 0 && consume_socket(ctx, &conn->client)) {
     conn->birth_time = time(NULL);
     conn->ctx = ctx;
+    conn->detached = 0;
 
     // Fill in IP, port info early so even if SSL setup below fails,
     // error handler would have the corresponding info.
@@ -3934,6 +4084,88 @@ static void produce_socket(struct mg_context *ctx, const struct socket *sp) {
   (void) pthread_mutex_unlock(&ctx->mutex);
 }
 
+static char *relocate(char *p, const char *from, int size, char *to) {
+  return p != NULL && p >= from && p < from + size ? to + (p - from) : p;
+}
+
+struct mg_connection *mg_detach(struct mg_connection *conn) {
+  struct mg_connection *copy;
+  struct mg_request_info *ri;
+  int i;
+
+  copy = (struct mg_connection *) malloc(sizeof(*conn) + conn->buf_size);
+  if (copy == NULL) {
+    return NULL;
+  }
+  memcpy(copy, conn, sizeof(*conn));
+  copy->buf = (char *) (copy + 1);
+  memcpy(copy->buf, conn->buf, (size_t) conn->data_len);
+
+  // Request info points into the request buffer: point it into the copy
+  ri = &copy->request_info;
+  ri->request_method = relocate(ri->request_method, conn->buf, conn->buf_size, copy->buf);
+  ri->uri = relocate(ri->uri, conn->buf, conn->buf_size, copy->buf);
+  ri->http_version = relocate(ri->http_version, conn->buf, conn->buf_size, copy->buf);
+  ri->query_string = relocate(ri->query_string, conn->buf, conn->buf_size, copy->buf);
+  ri->log_message = NULL;
+  for (i = 0; i < ri->num_headers; i++) {
+    ri->http_headers[i].name = relocate(ri->http_headers[i].name, conn->buf, conn->buf_size, copy->buf);
+    ri->http_headers[i].value = relocate(ri->http_headers[i].value, conn->buf, conn->buf_size, copy->buf);
+  }
+
+  // The worker thread must neither close nor reuse the socket anymore
+  conn->request_info.remote_user = NULL;
+  conn->ssl = NULL;
+  conn->client.sock = INVALID_SOCKET;
+  conn->detached = 1;
+
+  return copy;
+}
+
+// Same as produce_socket(), but never waits for a free slot in the queue.
+static int try_produce_socket(struct mg_context *ctx, const struct socket *sp) {
+  int produced = 0;
+
+  (void) pthread_mutex_lock(&ctx->mutex);
+  if (ctx->stop_flag == 0 &&
+      ctx->sq_head - ctx->sq_tail < (int) ARRAY_SIZE(ctx->queue)) {
+    ctx->queue[ctx->sq_head % ARRAY_SIZE(ctx->queue)] = *sp;
+    ctx->sq_head++;
+    produced = 1;
+    (void) pthread_cond_signal(&ctx->sq_full);
+  }
+  (void) pthread_mutex_unlock(&ctx->mutex);
+
+  return produced;
+}
+
+void mg_close_detached(struct mg_connection *conn, int keep_alive) {
+  int buffered_len, body_len;
+
+  if (conn == NULL) {
+    return;
+  }
+
+  // A kept alive connection goes back to the worker threads, unless data
+  // of the next request has already been read in (or the body of this one
+  // has not), or it is SSL-ed: the worker would not know about either.
+  buffered_len = conn->data_len - conn->request_len;
+  body_len = conn->content_len == -1 ? 0 :
+    (int) (conn->content_len < buffered_len ? conn->content_len : buffered_len);
+  keep_alive = keep_alive && conn->ssl == NULL && conn->peer == NULL &&
+    !strcmp(conn->ctx->config[ENABLE_KEEP_ALIVE], "yes") &&
+    should_keep_alive(conn) && buffered_len == body_len &&
+    (conn->content_len == -1 || conn->consumed_content == conn->content_len);
+
+  if (!keep_alive || !try_produce_socket(conn->ctx, &conn->client)) {
+    close_connection(conn);
+  }
+  if (conn->request_info.remote_user != NULL) {
+    free((void *) conn->request_info.remote_user);
+  }
+  free(conn);
+}
+
 static void accept_new_connection(const struct socket *listener,
                                   struct mg_context *ctx) {
   struct socket accepted;
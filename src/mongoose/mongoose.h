@@ -156,10 +156,47 @@ int mg_write(struct mg_connection *, const void *buf, size_t len);
 int mg_printf(struct mg_connection *, const char *fmt, ...);
 
 
+// Take over the connection of the request being handled, e.g. to answer it
+// asynchronously. Once the callback returns, the worker thread goes back to
+// the pool without touching the socket. The returned connection can be used
+// with mg_write(), mg_printf() and mg_read() from any thread, one at a time,
+// until it is released with mg_close_detached().
+//
+// Return:
+//   the detached connection, or NULL on error (conn is unchanged then).
+struct mg_connection *mg_detach(struct mg_connection *);
+
+
+// Release a connection returned by mg_detach().
+// If keep_alive is non-zero and the request allows it, the socket is handed
+// back to the worker threads for the next request, otherwise it is closed.
+void mg_close_detached(struct mg_connection *, int keep_alive);
+
+
 // Read data from the remote end, return number of bytes read.
 int mg_read(struct mg_connection *, void *buf, size_t len);
 
 
+// Read at most len bytes of the request body, without waiting for more data
+// than the client has sent so far, and ignoring Content-Length: used for
+// bodies sent with "Transfer-Encoding: chunked". Do not mix with mg_read().
+// Return the number of bytes read, 0 if the connection was closed, -1 on error.
+int mg_read_some(struct mg_connection *, void *buf, size_t len);
+
+
+// Return the socket of the connection, e.g. to watch a detached connection
+// for incoming data. Reading from it directly bypasses buffered data: use
+// mg_read_some() when it becomes readable.
+long long mg_get_socket(const struct mg_connection *);
+
+
+// Answer the current GET or HEAD request with the file at path, like files
+// under document_root are served: index files, ETag and Last-Modified
+// validation, and byte ranges are supported.
+// Return the HTTP status code that was sent.
+int mg_send_file(struct mg_connection *, const char *path);
+
+
 // Get the value of particular HTTP header.
 //
 // This is a helper function. It traverses request_info->http_headers array,
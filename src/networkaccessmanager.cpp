@@ -32,6 +32,7 @@
 #include <QDateTime>
 #include <QDesktopServices>
 #include <QNetworkDiskCache>
+#include <QNetworkProxyFactory>
 #include <QNetworkRequest>
 #include <QSslSocket>
 #include <QSslCertificate>
@@ -42,10 +43,26 @@
 #include "phantom.h"
 #include "config.h"
 #include "cookiejar.h"
+#include "hostresolver.h"
 #include "networkaccessmanager.h"
+#include "networkreplyproxy.h"
 
 // 10 MB
 const qint64 MAX_REQUEST_POST_BODY_SIZE = 10 * 1000 * 1000;
+// Bodies up to this size are also copied in the "postData" field of "onResourceRequested",
+// larger ones are only available through JsNetworkRequest::postData()
+const qint64 MAX_INLINE_POST_BODY_SIZE = 64 * 1024;
+
+// @return true if requests to @p url go through a proxy
+static bool isProxied(const QNetworkAccessManager* manager, const QUrl& url)
+{
+    QNetworkProxy proxy = manager->proxy();
+    if (proxy.type() == QNetworkProxy::DefaultProxy) {
+        const QList<QNetworkProxy> proxies = QNetworkProxyFactory::proxyForQuery(QNetworkProxyQuery(url));
+        proxy = proxies.isEmpty() ? QNetworkProxy(QNetworkProxy::NoProxy) : proxies.first();
+    }
+    return proxy.type() != QNetworkProxy::NoProxy && proxy.type() != QNetworkProxy::DefaultProxy;
+}
 
 static const char* toString(QNetworkAccessManager::Operation op)
 {
@@ -103,8 +120,9 @@ TimeoutTimer::TimeoutTimer(QObject* parent)
 }
 
 
-JsNetworkRequest::JsNetworkRequest(QNetworkRequest* request, QObject* parent)
+JsNetworkRequest::JsNetworkRequest(QNetworkRequest* request, QIODevice* outgoingData, QObject* parent)
     : QObject(parent)
+    , m_outgoingData(outgoingData)
 {
     m_networkRequest = request;
 }
@@ -135,6 +153,34 @@ void JsNetworkRequest::changeUrl(const QString& address)
     }
 }
 
+QString JsNetworkRequest::postData(const QString& encoding) const
+{
+    if (!m_outgoingData) {
+        return QString();
+    }
+
+    // peek() leaves the body untouched for the actual upload
+    const QByteArray data = m_outgoingData->peek(MAX_REQUEST_POST_BODY_SIZE);
+    if (encoding.toLower() == "binary") {
+        return QString::fromLatin1(data.constData(), data.size());
+    }
+    return QString::fromUtf8(data.constData(), data.size());
+}
+
+qint64 JsNetworkRequest::postDataSize() const
+{
+    if (!m_outgoingData) {
+        return -1;
+    }
+    if (!m_outgoingData->isSequential()) {
+        return m_outgoingData->size() - m_outgoingData->pos();
+    }
+    if (m_networkRequest && m_networkRequest->header(QNetworkRequest::ContentLengthHeader).isValid()) {
+        return m_networkRequest->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+    }
+    return -1;
+}
+
 struct ssl_protocol_option {
     const char* name;
     QSsl::SslProtocol proto;
@@ -162,6 +208,9 @@ NetworkAccessManager::NetworkAccessManager(QObject* parent, const Config* config
     , m_networkDiskCache(0)
     , m_sslConfiguration(QSslConfiguration::defaultConfiguration())
 {
+    m_clock.start();
+    resetNetworkStats();
+
     if (config->diskCacheEnabled()) {
         m_networkDiskCache = new QNetworkDiskCache(this);
 
@@ -291,6 +340,63 @@ QVariantMap NetworkAccessManager::customHeaders() const
     return m_customHeaders;
 }
 
+void NetworkAccessManager::setResponseFilters(const QVariantList& filters)
+{
+    m_responseFilters.clear();
+    foreach(const QVariant & rule, filters) {
+        ResponseFilter filter(rule.toMap());
+        if (filter.isValid()) {
+            m_responseFilters.append(filter);
+        } else {
+            qWarning() << "Ignoring invalid response filter" << rule;
+        }
+    }
+}
+
+QVariantList NetworkAccessManager::responseFilters() const
+{
+    QVariantList filters;
+    foreach(const ResponseFilter & filter, m_responseFilters) {
+        filters.append(filter.rule());
+    }
+    return filters;
+}
+
+QVariantMap NetworkAccessManager::networkStats() const
+{
+    QVariantMap stats;
+    stats["requests"] = m_requestCount;
+    stats["finished"] = m_finishedCount;
+    stats["pending"] = m_replyStats.size();
+    stats["errors"] = m_errorCount;
+    stats["timeouts"] = m_timeoutCount;
+    stats["redirects"] = m_redirectCount;
+    stats["cacheHits"] = m_cacheHitCount;
+    stats["tlsHandshakes"] = m_tlsHandshakeCount;
+    stats["bytesSent"] = m_bytesSent;
+    stats["bytesReceived"] = m_bytesReceived;
+    // Milliseconds, summed over finished requests: from the request to the first byte of the response,
+    // then from the first byte to the end of the response
+    stats["waitingTime"] = m_waitingTime;
+    stats["receivingTime"] = m_receivingTime;
+    return stats;
+}
+
+void NetworkAccessManager::resetNetworkStats()
+{
+    m_requestCount = 0;
+    m_finishedCount = 0;
+    m_errorCount = 0;
+    m_timeoutCount = 0;
+    m_redirectCount = 0;
+    m_cacheHitCount = 0;
+    m_tlsHandshakeCount = 0;
+    m_bytesSent = 0;
+    m_bytesReceived = 0;
+    m_waitingTime = 0;
+    m_receivingTime = 0;
+}
+
 void NetworkAccessManager::setCookieJar(QNetworkCookieJar* cookieJar)
 {
     QNetworkAccessManager::setCookieJar(cookieJar);
@@ -319,11 +425,9 @@ QNetworkReply* NetworkAccessManager::createRequest(Operation op, const QNetworkR
     // Get the URL string before calling the superclass. Seems to work around
     // segfaults in Qt 4.8: https://gist.github.com/1430393
     QByteArray url = req.url().toEncoded();
-    QByteArray postData;
 
     // http://code.google.com/p/phantomjs/issues/detail?id=337
     if (op == QNetworkAccessManager::PostOperation) {
-        if (outgoingData) { postData = outgoingData->peek(MAX_REQUEST_POST_BODY_SIZE); }
         QString contentType = req.header(QNetworkRequest::ContentTypeHeader).toString();
         if (contentType.isEmpty()) {
             req.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
@@ -347,17 +451,62 @@ QNetworkReply* NetworkAccessManager::createRequest(Operation op, const QNetworkR
         headers += header;
     }
 
+    JsNetworkRequest jsNetworkRequest(&req, outgoingData, this);
+
     QVariantMap data;
     data["id"] = m_idCounter;
     data["url"] = url.data();
     data["method"] = toString(op);
     data["headers"] = headers;
-    if (op == QNetworkAccessManager::PostOperation) { data["postData"] = postData.data(); }
+    if (op == QNetworkAccessManager::PostOperation) {
+        // Don't copy large bodies for every request: scripts that need them call networkRequest.postData()
+        const qint64 postDataSize = jsNetworkRequest.postDataSize();
+        data["postDataSize"] = postDataSize;
+        if (postDataSize >= 0 && postDataSize <= MAX_INLINE_POST_BODY_SIZE) {
+            data["postData"] = jsNetworkRequest.postData();
+        } else if (postDataSize < 0 && outgoingData) {
+            // Unknown size: inline the body if what is readable fits
+            const QByteArray body = outgoingData->peek(MAX_INLINE_POST_BODY_SIZE + 1);
+            if (body.size() <= MAX_INLINE_POST_BODY_SIZE) {
+                data["postData"] = QString::fromUtf8(body.constData(), body.size());
+            }
+        }
+    }
     data["time"] = QDateTime::currentDateTime();
 
-    JsNetworkRequest jsNetworkRequest(&req, this);
     emit resourceRequested(data, &jsNetworkRequest);
 
+    // Apply the host resolver rules and the DNS cache: the request goes on
+    // the wire to the resolved host, but WebKit keeps seeing the original URL.
+    // The DNS cache puts the address in the URL: skip it when the URL is also
+    // the disk cache key, or the absolute URI a proxy receives.
+    QNetworkRequest originalReq(req);
+    const bool useDnsCache = HostResolver::instance()->cacheTtl() > 0
+                             && !m_networkDiskCache && !isProxied(this, req.url());
+    QUrl resolvedUrl = HostResolver::instance()->resolve(req.url(), useDnsCache);
+    bool hostResolved = (resolvedUrl != req.url());
+    if (hostResolved) {
+        QByteArray host = req.url().host(QUrl::FullyEncoded).toLatin1();
+        if (req.url().port() != -1) {
+            host += ':' + QByteArray::number(req.url().port());
+        }
+        if (req.rawHeader("Host").isEmpty()) {
+            req.setRawHeader("Host", host);
+        }
+
+        // Cookies belong to the original host, not to the address we connect to
+        req.setAttribute(QNetworkRequest::CookieLoadControlAttribute, QNetworkRequest::Manual);
+        req.setAttribute(QNetworkRequest::CookieSaveControlAttribute, QNetworkRequest::Manual);
+        if (cookieJar()) {
+            QList<QNetworkCookie> cookies = cookieJar()->cookiesForUrl(req.url());
+            if (!cookies.isEmpty()) {
+                req.setHeader(QNetworkRequest::CookieHeader, QVariant::fromValue(cookies));
+            }
+        }
+
+        req.setUrl(resolvedUrl);
+    }
+
     // file: URLs may be disabled.
     // The second half of this conditional must match
     // QNetworkAccessManager's own idea of what a local file URL is.
@@ -369,6 +518,24 @@ QNetworkReply* NetworkAccessManager::createRequest(Operation op, const QNetworkR
         reply = QNetworkAccessManager::createRequest(op, req, outgoingData);
     }
 
+    // Response filters are matched against the URL WebKit asked for
+    QList<ResponseFilter> filters;
+    foreach(const ResponseFilter & filter, m_responseFilters) {
+        if (filter.matches(originalReq.url())) {
+            filters.append(filter);
+        }
+    }
+
+    if (hostResolved || !filters.isEmpty()) {
+        NetworkReplyProxy* proxy = new NetworkReplyProxy(this, reply, originalReq);
+        proxy->setResponseFilters(filters);
+        if (hostResolved) {
+            connect(proxy, SIGNAL(metaDataChanged()), this, SLOT(handleProxyMetaDataChanged()));
+        }
+        connect(proxy, SIGNAL(finished()), this, SLOT(handleProxyFinished()));
+        reply = proxy;
+    }
+
     // reparent jsNetworkRequest to make sure that it will be destroyed with QNetworkReply
     jsNetworkRequest.setParent(reply);
 
@@ -387,9 +554,20 @@ QNetworkReply* NetworkAccessManager::createRequest(Operation op, const QNetworkR
 
     m_ids[reply] = m_idCounter;
 
+    ReplyStats replyStats;
+    replyStats.startedAt = m_clock.elapsed();
+    replyStats.firstByteAt = -1;
+    replyStats.bytesSent = 0;
+    replyStats.bytesReceived = 0;
+    m_replyStats[reply] = replyStats;
+    ++m_requestCount;
+
     connect(reply, SIGNAL(readyRead()), this, SLOT(handleStarted()));
     connect(reply, SIGNAL(sslErrors(const QList<QSslError>&)), this, SLOT(handleSslErrors(const QList<QSslError>&)));
     connect(reply, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(handleNetworkError()));
+    connect(reply, SIGNAL(encrypted()), this, SLOT(handleEncrypted()));
+    connect(reply, SIGNAL(uploadProgress(qint64, qint64)), this, SLOT(handleUploadProgress(qint64, qint64)));
+    connect(reply, SIGNAL(downloadProgress(qint64, qint64)), this, SLOT(handleDownloadProgress(qint64, qint64)));
 
     return reply;
 }
@@ -402,6 +580,8 @@ void NetworkAccessManager::handleTimeout()
         return;
     }
 
+    ++m_timeoutCount;
+
     nt->data["errorCode"] = 408;
     nt->data["errorString"] = "Network timeout on resource.";
 
@@ -422,6 +602,9 @@ void NetworkAccessManager::handleStarted()
     }
 
     m_started += reply;
+    if (m_replyStats.contains(reply)) {
+        m_replyStats[reply].firstByteAt = m_clock.elapsed();
+    }
 
     QVariantList headers = getHeadersFromReply(reply);
 
@@ -453,6 +636,29 @@ void NetworkAccessManager::handleFinished(QNetworkReply* reply)
     this->handleFinished(reply, status, statusText);
 }
 
+void NetworkAccessManager::handleProxyFinished()
+{
+    // QNetworkAccessManager::finished() only reports the proxied reply
+    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
+    if (reply) {
+        handleFinished(reply);
+    }
+}
+
+void NetworkAccessManager::handleProxyMetaDataChanged()
+{
+    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
+    if (!reply || !cookieJar()) {
+        return;
+    }
+
+    // Store the cookies against the URL WebKit asked for
+    QList<QNetworkCookie> cookies = qvariant_cast<QList<QNetworkCookie> >(reply->header(QNetworkRequest::SetCookieHeader));
+    if (!cookies.isEmpty()) {
+        cookieJar()->setCookiesFromUrl(cookies, reply->url());
+    }
+}
+
 void NetworkAccessManager::provideAuthentication(QNetworkReply* reply, QAuthenticator* authenticator)
 {
     if (m_authAttempts++ < m_maxAuthAttempts) {
@@ -480,6 +686,26 @@ void NetworkAccessManager::handleFinished(QNetworkReply* reply, const QVariant&
     data["headers"] = headers;
     data["time"] = QDateTime::currentDateTime();
 
+    if (m_replyStats.contains(reply)) {
+        const ReplyStats replyStats = m_replyStats.take(reply);
+        const qint64 now = m_clock.elapsed();
+        ++m_finishedCount;
+        m_bytesSent += replyStats.bytesSent;
+        m_bytesReceived += replyStats.bytesReceived;
+        if (replyStats.firstByteAt < 0) {
+            m_waitingTime += now - replyStats.startedAt;
+        } else {
+            m_waitingTime += replyStats.firstByteAt - replyStats.startedAt;
+            m_receivingTime += now - replyStats.firstByteAt;
+        }
+        if (reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool()) {
+            ++m_cacheHitCount;
+        }
+        if (reply->attribute(QNetworkRequest::RedirectionTargetAttribute).isValid()) {
+            ++m_redirectCount;
+        }
+    }
+
     m_ids.remove(reply);
     m_started.remove(reply);
     reply->deleteLater();
@@ -499,9 +725,33 @@ void NetworkAccessManager::handleSslErrors(const QList<QSslError>& errors)
     }
 }
 
+void NetworkAccessManager::handleEncrypted()
+{
+    ++m_tlsHandshakeCount;
+}
+
+void NetworkAccessManager::handleUploadProgress(qint64 bytesSent, qint64 bytesTotal)
+{
+    Q_UNUSED(bytesTotal);
+    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
+    if (m_replyStats.contains(reply)) {
+        m_replyStats[reply].bytesSent = bytesSent;
+    }
+}
+
+void NetworkAccessManager::handleDownloadProgress(qint64 bytesReceived, qint64 bytesTotal)
+{
+    Q_UNUSED(bytesTotal);
+    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
+    if (m_replyStats.contains(reply)) {
+        m_replyStats[reply].bytesReceived = bytesReceived;
+    }
+}
+
 void NetworkAccessManager::handleNetworkError()
 {
     QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
+    ++m_errorCount;
     qDebug() << "Network - Resource request error:"
              << reply->error()
              << "(" << reply->errorString() << ")"
@@ -31,12 +31,16 @@
 #ifndef NETWORKACCESSMANAGER_H
 #define NETWORKACCESSMANAGER_H
 
+#include <QElapsedTimer>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
+#include <QPointer>
 #include <QSslConfiguration>
 #include <QTimer>
 #include <QStringList>
 
+#include "responsefilter.h"
+
 class Config;
 class QAuthenticator;
 class QNetworkDiskCache;
@@ -55,15 +59,25 @@ public:
 class JsNetworkRequest : public QObject
 {
     Q_OBJECT
+    Q_PROPERTY(qint64 postDataSize READ postDataSize)
 
 public:
-    JsNetworkRequest(QNetworkRequest* request, QObject* parent = 0);
+    JsNetworkRequest(QNetworkRequest* request, QIODevice* outgoingData = 0, QObject* parent = 0);
     Q_INVOKABLE void abort();
     Q_INVOKABLE void changeUrl(const QString& url);
     Q_INVOKABLE bool setHeader(const QString& name, const QVariant& value);
+    /**
+     * Body of a POST/PUT request, read on demand (only valid while handling "onResourceRequested").
+     * With @p encoding "binary", every byte maps to one character (as in "fs" binary mode),
+     * otherwise the body is decoded as UTF-8.
+     */
+    Q_INVOKABLE QString postData(const QString& encoding = QString()) const;
+    /// Size of the request body in bytes, or -1 if unknown
+    qint64 postDataSize() const;
 
 private:
     QNetworkRequest* m_networkRequest;
+    QPointer<QIODevice> m_outgoingData;
 };
 
 class NoFileAccessReply : public QNetworkReply
@@ -89,6 +103,11 @@ public:
     void setResourceTimeout(int resourceTimeout);
     void setCustomHeaders(const QVariantMap& headers);
     QVariantMap customHeaders() const;
+    void setResponseFilters(const QVariantList& filters);
+    QVariantList responseFilters() const;
+    /// Counters for every request made through this manager since creation (or the last reset)
+    QVariantMap networkStats() const;
+    void resetNetworkStats();
     QStringList captureContent() const;
     void setCaptureContent(const QStringList& patterns);
 
@@ -114,8 +133,13 @@ signals:
 private slots:
     void handleStarted();
     void handleFinished(QNetworkReply* reply);
+    void handleProxyFinished();
+    void handleProxyMetaDataChanged();
     void provideAuthentication(QNetworkReply* reply, QAuthenticator* authenticator);
     void handleSslErrors(const QList<QSslError>& errors);
+    void handleEncrypted();
+    void handleUploadProgress(qint64 bytesSent, qint64 bytesTotal);
+    void handleDownloadProgress(qint64 bytesReceived, qint64 bytesTotal);
     void handleNetworkError();
     void handleTimeout();
 
@@ -123,11 +147,32 @@ private:
     void prepareSslConfiguration(const Config* config);
     QVariantList getHeadersFromReply(const QNetworkReply* reply);
 
+    struct ReplyStats {
+        qint64 startedAt;
+        qint64 firstByteAt;
+        qint64 bytesSent;
+        qint64 bytesReceived;
+    };
+
     QHash<QNetworkReply*, int> m_ids;
+    QHash<QNetworkReply*, ReplyStats> m_replyStats;
+    QElapsedTimer m_clock;
+    qint64 m_requestCount;
+    qint64 m_finishedCount;
+    qint64 m_errorCount;
+    qint64 m_timeoutCount;
+    qint64 m_redirectCount;
+    qint64 m_cacheHitCount;
+    qint64 m_tlsHandshakeCount;
+    qint64 m_bytesSent;
+    qint64 m_bytesReceived;
+    qint64 m_waitingTime;
+    qint64 m_receivingTime;
     QSet<QNetworkReply*> m_started;
     int m_idCounter;
     QNetworkDiskCache* m_networkDiskCache;
     QVariantMap m_customHeaders;
+    QList<ResponseFilter> m_responseFilters;
     QSslConfiguration m_sslConfiguration;
 };
 
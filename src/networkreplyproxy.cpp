@@ -0,0 +1,207 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "networkreplyproxy.h"
+
+#include <QSslConfiguration>
+
+NetworkReplyProxy::NetworkReplyProxy(QObject* parent, QNetworkReply* reply, const QNetworkRequest& request)
+    : QNetworkReply(parent)
+    , m_reply(reply)
+{
+    // The proxied reply lives (and dies) with this one
+    m_reply->setParent(this);
+
+    setRequest(request);
+    setUrl(request.url());
+    setOperation(m_reply->operation());
+    open(ReadOnly | Unbuffered);
+
+    connect(m_reply, SIGNAL(metaDataChanged()), SLOT(handleMetaDataChanged()));
+    connect(m_reply, SIGNAL(readyRead()), SLOT(handleReadyRead()));
+    connect(m_reply, SIGNAL(error(QNetworkReply::NetworkError)), SLOT(handleError(QNetworkReply::NetworkError)));
+    connect(m_reply, SIGNAL(finished()), SLOT(handleFinished()));
+    connect(m_reply, SIGNAL(encrypted()), SIGNAL(encrypted()));
+    connect(m_reply, SIGNAL(sslErrors(QList<QSslError>)), SIGNAL(sslErrors(QList<QSslError>)));
+    connect(m_reply, SIGNAL(uploadProgress(qint64, qint64)), SIGNAL(uploadProgress(qint64, qint64)));
+    connect(m_reply, SIGNAL(downloadProgress(qint64, qint64)), SIGNAL(downloadProgress(qint64, qint64)));
+}
+
+QNetworkReply* NetworkReplyProxy::reply() const
+{
+    return m_reply;
+}
+
+void NetworkReplyProxy::setResponseFilters(const QList<ResponseFilter>& filters)
+{
+    m_headerFilters.clear();
+    foreach(const ResponseFilter & filter, filters) {
+        if (!filter.isBodyFilter()) {
+            m_headerFilters.append(filter);
+        }
+    }
+    m_rewriter.setFilters(filters);
+}
+
+void NetworkReplyProxy::abort()
+{
+    m_reply->abort();
+}
+
+void NetworkReplyProxy::close()
+{
+    m_reply->close();
+    QNetworkReply::close();
+}
+
+bool NetworkReplyProxy::isSequential() const
+{
+    return m_reply->isSequential();
+}
+
+qint64 NetworkReplyProxy::bytesAvailable() const
+{
+    if (m_rewriter.isActive()) {
+        return m_buffer.size() + QNetworkReply::bytesAvailable();
+    }
+    return m_reply->bytesAvailable() + QNetworkReply::bytesAvailable();
+}
+
+void NetworkReplyProxy::setReadBufferSize(qint64 size)
+{
+    QNetworkReply::setReadBufferSize(size);
+    m_reply->setReadBufferSize(size);
+}
+
+void NetworkReplyProxy::ignoreSslErrors()
+{
+    m_reply->ignoreSslErrors();
+}
+
+// protected:
+qint64 NetworkReplyProxy::readData(char* data, qint64 maxSize)
+{
+    if (m_rewriter.isActive()) {
+        if (m_buffer.isEmpty()) {
+            return isFinished() ? -1 : 0;
+        }
+        const qint64 size = qMin(maxSize, qint64(m_buffer.size()));
+        memcpy(data, m_buffer.constData(), size);
+        m_buffer.remove(0, size);
+        return size;
+    }
+
+    // Read straight from the proxied reply: no intermediate copy
+    return m_reply->read(data, maxSize);
+}
+
+void NetworkReplyProxy::sslConfigurationImplementation(QSslConfiguration& configuration) const
+{
+    configuration = m_reply->sslConfiguration();
+}
+
+void NetworkReplyProxy::setSslConfigurationImplementation(const QSslConfiguration& configuration)
+{
+    m_reply->setSslConfiguration(configuration);
+}
+
+void NetworkReplyProxy::ignoreSslErrorsImplementation(const QList<QSslError>& errors)
+{
+    m_reply->ignoreSslErrors(errors);
+}
+
+// private slots:
+void NetworkReplyProxy::handleMetaDataChanged()
+{
+    // Qt parses the well-known headers (Content-Type, Location, Set-Cookie...) out of the raw ones
+    foreach(const QNetworkReply::RawHeaderPair & header, m_reply->rawHeaderPairs()) {
+        setRawHeader(header.first, header.second);
+    }
+
+    static const QNetworkRequest::Attribute attributes[] = {
+        QNetworkRequest::HttpStatusCodeAttribute,
+        QNetworkRequest::HttpReasonPhraseAttribute,
+        QNetworkRequest::RedirectionTargetAttribute,
+        QNetworkRequest::ConnectionEncryptedAttribute,
+        QNetworkRequest::SourceIsFromCacheAttribute,
+        QNetworkRequest::HttpPipeliningWasUsedAttribute,
+        QNetworkRequest::SpdyWasUsedAttribute
+    };
+    for (uint i = 0; i < sizeof(attributes) / sizeof(attributes[0]); ++i) {
+        const QVariant value = m_reply->attribute(attributes[i]);
+        if (value.isValid()) {
+            setAttribute(attributes[i], value);
+        }
+    }
+
+    foreach(const ResponseFilter & filter, m_headerFilters) {
+        if (filter.type() == ResponseFilter::SetHeader) {
+            setRawHeader(filter.headerName(), filter.headerValue());
+        } else {
+            setRawHeader(filter.headerName(), QByteArray());
+        }
+    }
+    if (m_rewriter.isActive()) {
+        // The rewritten body won't have the announced length
+        setHeader(QNetworkRequest::ContentLengthHeader, QVariant());
+    }
+
+    emit metaDataChanged();
+}
+
+void NetworkReplyProxy::handleReadyRead()
+{
+    if (!m_rewriter.isActive()) {
+        emit readyRead();
+        return;
+    }
+
+    m_buffer += m_rewriter.write(m_reply->readAll());
+    if (!m_buffer.isEmpty()) {
+        emit readyRead();
+    }
+}
+
+void NetworkReplyProxy::handleError(QNetworkReply::NetworkError code)
+{
+    setError(code, m_reply->errorString());
+    emit error(code);
+}
+
+void NetworkReplyProxy::handleFinished()
+{
+    if (m_rewriter.isActive()) {
+        m_buffer += m_rewriter.write(m_reply->readAll());
+        m_buffer += m_rewriter.finish();
+        if (!m_buffer.isEmpty()) {
+            emit readyRead();
+        }
+    }
+
+    setFinished(true);
+    emit finished();
+}
@@ -0,0 +1,86 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef NETWORKREPLYPROXY_H
+#define NETWORKREPLYPROXY_H
+
+#include <QNetworkReply>
+#include <QNetworkRequest>
+
+#include "responsefilter.h"
+
+/**
+ * QNetworkReply that forwards everything to another reply,
+ * but presents the request (and URL) it was given.
+ *
+ * Used when the request that actually goes on the wire differs from the
+ * one WebKit asked for (e.g. the host was rewritten by HostResolver):
+ * WebKit keeps seeing the original URL for the document, redirects and cookies.
+ *
+ * It also applies the page's response filters to the headers and the body
+ * as they arrive.
+ */
+class NetworkReplyProxy : public QNetworkReply
+{
+    Q_OBJECT
+
+public:
+    NetworkReplyProxy(QObject* parent, QNetworkReply* reply, const QNetworkRequest& request);
+
+    QNetworkReply* reply() const;
+
+    void setResponseFilters(const QList<ResponseFilter>& filters);
+
+    void abort();
+    void close();
+    bool isSequential() const;
+    qint64 bytesAvailable() const;
+    void setReadBufferSize(qint64 size);
+
+public slots:
+    void ignoreSslErrors();
+
+protected:
+    qint64 readData(char* data, qint64 maxSize);
+    void sslConfigurationImplementation(QSslConfiguration& configuration) const;
+    void setSslConfigurationImplementation(const QSslConfiguration& configuration);
+    void ignoreSslErrorsImplementation(const QList<QSslError>& errors);
+
+private slots:
+    void handleMetaDataChanged();
+    void handleReadyRead();
+    void handleError(QNetworkReply::NetworkError code);
+    void handleFinished();
+
+private:
+    QNetworkReply* m_reply;
+    QList<ResponseFilter> m_headerFilters;
+    ResponseBodyRewriter m_rewriter;
+    QByteArray m_buffer;
+};
+
+#endif // NETWORKREPLYPROXY_H
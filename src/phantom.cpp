@@ -50,9 +50,15 @@
 #include "callback.h"
 #include "cookiejar.h"
 #include "childprocess.h"
+#include "hostresolver.h"
 
 static Phantom* phantomInstance = NULL;
 
+static CookieJar::StorageFormat cookieJarFormat(const Config& config)
+{
+    return config.cookiesFileFormat() == "journal" ? CookieJar::JournalFormat : CookieJar::IniFormat;
+}
+
 // private:
 Phantom::Phantom(QObject* parent)
     : QObject(parent)
@@ -97,8 +103,23 @@ void Phantom::init()
         return;
     }
 
+    // Apply host resolution settings before any request is made
+    if (!HostResolver::instance()->setRules(m_config.hostResolverRules())) {
+        Terminal::instance()->cerr("Invalid '--host-resolver-rules': " + m_config.hostResolverRules());
+        m_terminated = true;
+        return;
+    }
+    HostResolver::instance()->setCacheTtl(m_config.dnsCacheTtl());
+
+    // Falling back to 'ini' on a typo would let processes sharing a journal overwrite it
+    if (m_config.cookiesFileFormat() != "ini" && m_config.cookiesFileFormat() != "journal") {
+        Terminal::instance()->cerr("Invalid '--cookies-file-format': " + m_config.cookiesFileFormat());
+        m_terminated = true;
+        return;
+    }
+
     // Initialize the CookieJar
-    m_defaultCookieJar = new CookieJar(m_config.cookiesFile());
+    m_defaultCookieJar = new CookieJar(m_config.cookiesFile(), cookieJarFormat(m_config));
 
     QWebSettings::setOfflineWebApplicationCachePath(QStandardPaths::writableLocation(QStandardPaths::DataLocation));
     if (m_config.offlineStoragePath().isEmpty()) {
@@ -294,6 +315,21 @@ void Phantom::setCookiesEnabled(const bool value)
     }
 }
 
+QString Phantom::hostResolverRules() const
+{
+    return HostResolver::instance()->rules();
+}
+
+void Phantom::setHostResolverRules(const QString& rules)
+{
+    HostResolver::instance()->setRules(rules);
+}
+
+QVariantMap Phantom::hostResolverStats() const
+{
+    return HostResolver::instance()->stats();
+}
+
 bool Phantom::webdriverMode() const
 {
     return m_config.isWebdriverMode();
@@ -302,7 +338,7 @@ bool Phantom::webdriverMode() const
 // public slots:
 QObject* Phantom::createCookieJar(const QString& filePath)
 {
-    return new CookieJar(filePath, this);
+    return new CookieJar(filePath, cookieJarFormat(m_config), this);
 }
 
 QObject* Phantom::createWebPage()
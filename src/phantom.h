@@ -54,6 +54,8 @@ class Phantom : public QObject
     Q_PROPERTY(QObject* page READ page)
     Q_PROPERTY(bool cookiesEnabled READ areCookiesEnabled WRITE setCookiesEnabled)
     Q_PROPERTY(QVariantList cookies READ cookies WRITE setCookies)
+    Q_PROPERTY(QString hostResolverRules READ hostResolverRules WRITE setHostResolverRules)
+    Q_PROPERTY(QVariantMap hostResolverStats READ hostResolverStats)
     Q_PROPERTY(bool webdriverMode READ webdriverMode)
     Q_PROPERTY(int remoteDebugPort READ remoteDebugPort)
 
@@ -95,6 +97,17 @@ public:
     bool areCookiesEnabled() const;
     void setCookiesEnabled(const bool value);
 
+    /**
+     * Rules applied to the host name of every request,
+     * in the same format as the "--host-resolver-rules" option.
+     */
+    QString hostResolverRules() const;
+    void setHostResolverRules(const QString& rules);
+    /**
+     * Lookup counters of the process-wide DNS cache (see "--dns-cache-ttl").
+     */
+    QVariantMap hostResolverStats() const;
+
     bool webdriverMode() const;
 
     int remoteDebugPort() const;
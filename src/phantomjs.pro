@@ -24,10 +24,16 @@ HEADERS += \
     callback.h \
     webpage.h \
     webserver.h \
+    downloadmanager.h \
     consts.h \
     utils.h \
     networkaccessmanager.h \
+    networkreplyproxy.h \
+    responsefilter.h \
+    hostresolver.h \
     cookiejar.h \
+    cookiestore.h \
+    cookiejournal.h \
     filesystem.h \
     system.h \
     env.h \
@@ -42,10 +48,16 @@ SOURCES += phantom.cpp \
     callback.cpp \
     webpage.cpp \
     webserver.cpp \
+    downloadmanager.cpp \
     main.cpp \
     utils.cpp \
     networkaccessmanager.cpp \
+    networkreplyproxy.cpp \
+    responsefilter.cpp \
+    hostresolver.cpp \
     cookiejar.cpp \
+    cookiestore.cpp \
+    cookiejournal.cpp \
     filesystem.cpp \
     system.cpp \
     env.cpp \
@@ -70,6 +82,13 @@ include(mongoose/mongoose.pri)
 include(linenoise/linenoise.pri)
 include(qcommandline/qcommandline.pri)
 
+# zlib, for WebServer response compression: the copy bundled with QtCore, or the system one
+contains(QT_CONFIG, system-zlib) {
+    unix|mingw: LIBS += -lz
+} else {
+    INCLUDEPATH += $$[QT_INSTALL_HEADERS]/QtZlib
+}
+
 win32: RC_FILE = phantomjs_win.rc
 os2:   RC_FILE = phantomjs_os2.rc
 
@@ -81,6 +100,11 @@ mac {
 #    CONFIG += x86 ppc
 }
 
+win32 {
+    # GetProcessMemoryInfo(), for the WebServer metrics
+    LIBS += -lpsapi
+}
+
 win32-msvc* {
     DEFINES += NOMINMAX \
       WIN32_LEAN_AND_MEAN \
@@ -0,0 +1,192 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "responsefilter.h"
+
+ResponseFilter::ResponseFilter()
+    : m_type(Invalid)
+{
+}
+
+ResponseFilter::ResponseFilter(const QVariantMap& rule)
+    : m_type(Invalid)
+    , m_rule(rule)
+{
+    const QString type = rule.value("type").toString();
+    const QVariant url = rule.value("url");
+
+    if (url.type() == QVariant::RegExp) {
+        m_url = url.toRegExp();
+    } else if (!url.toString().isEmpty()) {
+        m_url = QRegExp(url.toString());
+    }
+    if (!m_url.isEmpty() && !m_url.isValid()) {
+        return;
+    }
+
+    if (type == "replace" || type == "replaceRegExp") {
+        const QString search = rule.value("search").toString();
+        if (search.isEmpty()) {
+            return;
+        }
+        m_search = search.toUtf8();
+        m_replace = rule.value("replace").toString().toUtf8();
+
+        if (type == "replace") {
+            m_type = ReplaceText;
+        } else {
+            // The body is matched byte by byte (as Latin-1),
+            // so non-ASCII literals are given as their UTF-8 bytes too
+            m_regExp = QRegExp(QString::fromLatin1(m_search),
+                               rule.value("ignoreCase").toBool() ? Qt::CaseInsensitive : Qt::CaseSensitive,
+                               QRegExp::RegExp2);
+            if (m_regExp.isValid()) {
+                m_type = ReplaceRegExp;
+            }
+        }
+    } else if (type == "setHeader" || type == "removeHeader") {
+        if (rule.value("name").toString().isEmpty()) {
+            return;
+        }
+        m_type = (type == "setHeader") ? SetHeader : RemoveHeader;
+    }
+}
+
+bool ResponseFilter::isValid() const
+{
+    return m_type != Invalid;
+}
+
+bool ResponseFilter::isBodyFilter() const
+{
+    return m_type == ReplaceText || m_type == ReplaceRegExp;
+}
+
+bool ResponseFilter::matches(const QUrl& url) const
+{
+    if (m_url.isEmpty()) {
+        return true;
+    }
+    return m_url.indexIn(url.toString()) != -1;
+}
+
+ResponseFilter::Type ResponseFilter::type() const
+{
+    return m_type;
+}
+
+QVariantMap ResponseFilter::rule() const
+{
+    return m_rule;
+}
+
+QByteArray ResponseFilter::headerName() const
+{
+    return m_rule.value("name").toString().toLatin1();
+}
+
+QByteArray ResponseFilter::headerValue() const
+{
+    return m_rule.value("value").toString().toLatin1();
+}
+
+
+ResponseBodyRewriter::ResponseBodyRewriter()
+{
+}
+
+void ResponseBodyRewriter::setFilters(const QList<ResponseFilter>& filters)
+{
+    m_stages.clear();
+    foreach(const ResponseFilter & filter, filters) {
+        if (filter.isBodyFilter()) {
+            Stage stage;
+            stage.filter = filter;
+            m_stages.append(stage);
+        }
+    }
+}
+
+bool ResponseBodyRewriter::isActive() const
+{
+    return !m_stages.isEmpty();
+}
+
+QByteArray ResponseBodyRewriter::write(const QByteArray& data)
+{
+    return process(data, false);
+}
+
+QByteArray ResponseBodyRewriter::finish()
+{
+    return process(QByteArray(), true);
+}
+
+// private:
+QByteArray ResponseBodyRewriter::process(const QByteArray& data, bool last)
+{
+    QByteArray output = data;
+    for (int i = 0; i < m_stages.size(); ++i) {
+        m_stages[i].pending += output;
+        output = apply(m_stages[i], last);
+        if (output.isEmpty() && !last) {
+            break;
+        }
+    }
+    return output;
+}
+
+QByteArray ResponseBodyRewriter::apply(Stage& stage, bool last)
+{
+    const ResponseFilter& filter = stage.filter;
+    QByteArray output;
+
+    if (filter.m_type == ResponseFilter::ReplaceRegExp) {
+        if (!last) {
+            return output;
+        }
+        QString text = QString::fromLatin1(stage.pending.constData(), stage.pending.size());
+        text.replace(filter.m_regExp, QString::fromLatin1(filter.m_replace));
+        stage.pending.clear();
+        return text.toLatin1();
+    }
+
+    const QByteArray& pending = stage.pending;
+    int pos = 0;
+    int index;
+    while ((index = pending.indexOf(filter.m_search, pos)) != -1) {
+        output += pending.mid(pos, index - pos);
+        output += filter.m_replace;
+        pos = index + filter.m_search.size();
+    }
+
+    // The tail might be the beginning of a match completed by the next chunk
+    const int keep = last ? 0 : qMin(pending.size() - pos, filter.m_search.size() - 1);
+    output += pending.mid(pos, pending.size() - pos - keep);
+    stage.pending = pending.right(keep);
+    return output;
+}
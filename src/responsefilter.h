@@ -0,0 +1,116 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef RESPONSEFILTER_H
+#define RESPONSEFILTER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QRegExp>
+#include <QUrl>
+#include <QVariantMap>
+
+/**
+ * A native rewriting rule for network replies, applied before WebKit sees them.
+ *
+ * Rules are given as objects:
+ *  - { type: "replace", search: "text", replace: "other text" }
+ *  - { type: "replaceRegExp", search: "regexp", replace: "text with \\1", ignoreCase: true }
+ *  - { type: "setHeader", name: "X-Header", value: "value" }
+ *  - { type: "removeHeader", name: "X-Header" }
+ * with an optional "url" regular expression (or RegExp) limiting the rule to matching URLs.
+ */
+class ResponseFilter
+{
+public:
+    enum Type {
+        Invalid,
+        ReplaceText,
+        ReplaceRegExp,
+        SetHeader,
+        RemoveHeader
+    };
+
+    ResponseFilter();
+    explicit ResponseFilter(const QVariantMap& rule);
+
+    bool isValid() const;
+    /// Whether the rule rewrites the body (as opposed to the headers)
+    bool isBodyFilter() const;
+    bool matches(const QUrl& url) const;
+
+    Type type() const;
+    QVariantMap rule() const;
+
+    QByteArray headerName() const;
+    QByteArray headerValue() const;
+
+private:
+    friend class ResponseBodyRewriter;
+
+    Type m_type;
+    QVariantMap m_rule;
+    QRegExp m_url;
+    QByteArray m_search;
+    QByteArray m_replace;
+    QRegExp m_regExp;
+};
+
+/**
+ * Applies a chain of body filters to a reply, chunk by chunk.
+ *
+ * Text replacements stream: each one only holds back the few bytes that
+ * could be the start of a match split across two chunks.
+ * Regular expressions can match anything, so their input is buffered
+ * until the end of the reply.
+ */
+class ResponseBodyRewriter
+{
+public:
+    ResponseBodyRewriter();
+
+    void setFilters(const QList<ResponseFilter>& filters);
+    bool isActive() const;
+
+    /// @return the rewritten data that is ready to be passed on
+    QByteArray write(const QByteArray& data);
+    /// @return whatever was still held back, once the reply is finished
+    QByteArray finish();
+
+private:
+    struct Stage {
+        ResponseFilter filter;
+        QByteArray pending;
+    };
+
+    QByteArray process(const QByteArray& data, bool last);
+    static QByteArray apply(Stage& stage, bool last);
+
+    QList<Stage> m_stages;
+};
+
+#endif // RESPONSEFILTER_H
@@ -38,6 +38,15 @@
 #include <QDir>
 #include <QtWebKitWidgets/QWebFrame>
 
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_MAC)
+#include <mach/mach.h>
+#elif defined(Q_OS_LINUX)
+#include <unistd.h>
+#endif
+
 static QString findScript(const QString& jsFilePath, const QString& libraryPath)
 {
     if (!jsFilePath.isEmpty()) {
@@ -163,4 +172,30 @@ QString readResourceFileUtf8(const QString& resourceFilePath)
     return QString::fromUtf8(f.readAll());
 }
 
+qint64 residentMemorySize()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.WorkingSetSize;
+    }
+#elif defined(Q_OS_MAC)
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) == KERN_SUCCESS) {
+        return info.resident_size;
+    }
+#elif defined(Q_OS_LINUX)
+    // second field: resident pages
+    QFile statm("/proc/self/statm");
+    if (statm.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> fields = statm.readAll().split(' ');
+        if (fields.size() > 1) {
+            return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+        }
+    }
+#endif
+    return -1;
+}
+
 }; // namespace Utils
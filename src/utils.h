@@ -74,6 +74,18 @@ bool loadJSForDebug(const QString& jsFilePath,
 
 QString readResourceFileUtf8(const QString& resourceFilePath);
 
+/**
+ * Resident set size of this process, in bytes, or -1 where unsupported.
+ * Safe to call from any thread.
+ */
+qint64 residentMemorySize();
+
 };
 
+/**
+ * Use like qDebug(), for messages on hot paths: unlike qDebug(),
+ * the arguments are not even formatted when debug output is disabled.
+ */
+#define phantomDebug() if (!Utils::printDebugMessages) {} else qDebug()
+
 #endif // UTILS_H
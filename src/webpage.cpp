@@ -66,6 +66,7 @@
 #include "consts.h"
 #include "callback.h"
 #include "cookiejar.h"
+#include "downloadmanager.h"
 #include "system.h"
 
 #ifdef Q_OS_WIN
@@ -350,6 +351,8 @@ private:
 };
 
 
+static QAtomicInt webPageInstances;
+
 WebPage::WebPage(QObject* parent, const QUrl& baseUrl)
     : QObject(parent)
     , m_navigationLocked(false)
@@ -435,14 +438,29 @@ WebPage::WebPage(QObject* parent, const QUrl& baseUrl)
     connect(m_networkAccessManager, SIGNAL(resourceTimeout(QVariant)),
             SIGNAL(resourceTimeout(QVariant)));
 
+    // Unsupported content (e.g. attachments) is streamed to disk once a download directory is set
+    m_downloadManager = new DownloadManager(this);
+    connect(m_customWebPage, SIGNAL(unsupportedContent(QNetworkReply*)),
+            m_downloadManager, SLOT(handleUnsupportedContent(QNetworkReply*)));
+    connect(m_downloadManager, SIGNAL(downloadStarted(QVariant)), SIGNAL(downloadStarted(QVariant)));
+    connect(m_downloadManager, SIGNAL(downloadProgress(QVariant)), SIGNAL(downloadProgress(QVariant)));
+    connect(m_downloadManager, SIGNAL(downloadFinished(QVariant)), SIGNAL(downloadFinished(QVariant)));
+
     m_customWebPage->setViewportSize(QSize(400, 300));
+    webPageInstances.ref();
 }
 
 WebPage::~WebPage()
 {
+    webPageInstances.deref();
     emit closing(this);
 }
 
+int WebPage::instanceCount()
+{
+    return webPageInstances.load();
+}
+
 QWebFrame* WebPage::mainFrame()
 {
     return m_mainFrame;
@@ -830,6 +848,36 @@ QVariantMap WebPage::customHeaders() const
     return m_networkAccessManager->customHeaders();
 }
 
+void WebPage::setResponseFilters(const QVariantList& filters)
+{
+    m_networkAccessManager->setResponseFilters(filters);
+}
+
+QVariantList WebPage::responseFilters() const
+{
+    return m_networkAccessManager->responseFilters();
+}
+
+QVariantMap WebPage::networkStats() const
+{
+    return m_networkAccessManager->networkStats();
+}
+
+void WebPage::resetNetworkStats()
+{
+    m_networkAccessManager->resetNetworkStats();
+}
+
+QString WebPage::downloadDirectory() const
+{
+    return m_downloadManager->directory();
+}
+
+void WebPage::setDownloadDirectory(const QString& directory)
+{
+    m_downloadManager->setDirectory(directory);
+}
+
 void WebPage::setCookieJar(CookieJar* cookieJar)
 {
     m_cookieJar = cookieJar;
@@ -1045,6 +1093,11 @@ bool WebPage::render(const QString& fileName, const QVariantMap& option)
 }
 
 QString WebPage::renderBase64(const QByteArray& format)
+{
+    return renderBytes(format).toBase64();
+}
+
+QByteArray WebPage::renderBytes(const QByteArray& format)
 {
     QByteArray nformat = format.toLower();
 
@@ -1057,14 +1110,14 @@ QString WebPage::renderBase64(const QByteArray& format)
         QBuffer buffer(&bytes);
         buffer.open(QIODevice::WriteOnly);
 
-        // Writing image to the buffer, using PNG encoding
+        // Writing image to the buffer, using the requested encoding
         rawPageRendering.save(&buffer, nformat);
 
-        return bytes.toBase64();
+        return bytes;
     }
 
-    // Return an empty string in case an unsupported format was provided
-    return "";
+    // Return an empty array in case an unsupported format was provided
+    return QByteArray();
 }
 
 QImage WebPage::renderImage()
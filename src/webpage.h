@@ -40,6 +40,7 @@
 
 class Config;
 class CustomPage;
+class DownloadManager;
 class WebpageCallbacks;
 class NetworkAccessManager;
 class QWebInspector;
@@ -69,6 +70,9 @@ class WebPage : public QObject, public QWebFrame::PrintCallback
     Q_PROPERTY(QVariantMap scrollPosition READ scrollPosition WRITE setScrollPosition)
     Q_PROPERTY(bool navigationLocked READ navigationLocked WRITE setNavigationLocked)
     Q_PROPERTY(QVariantMap customHeaders READ customHeaders WRITE setCustomHeaders)
+    Q_PROPERTY(QVariantList responseFilters READ responseFilters WRITE setResponseFilters)
+    Q_PROPERTY(QVariantMap networkStats READ networkStats)
+    Q_PROPERTY(QString downloadDirectory READ downloadDirectory WRITE setDownloadDirectory)
     Q_PROPERTY(qreal zoomFactor READ zoomFactor WRITE setZoomFactor)
     Q_PROPERTY(QVariantList cookies READ cookies WRITE setCookies)
     Q_PROPERTY(QString windowName READ windowName)
@@ -129,6 +133,14 @@ public:
     void setCustomHeaders(const QVariantMap& headers);
     QVariantMap customHeaders() const;
 
+    void setResponseFilters(const QVariantList& filters);
+    QVariantList responseFilters() const;
+
+    QVariantMap networkStats() const;
+
+    QString downloadDirectory() const;
+    void setDownloadDirectory(const QString& directory);
+
     int showInspector(const int remotePort = -1);
 
     QString footer(int page, int numPages);
@@ -234,6 +246,18 @@ public:
      */
     QString focusedFrameName() const;
 
+    /**
+     * Render the page as an encoded image, without the base-64 step of
+     * renderBase64(). Used by WebServerResponse::writeRender().
+     *
+     * @param format One of the formats supported by QImageWriter
+     * @return The encoded image, or an empty array if @p format is not supported
+     */
+    QByteArray renderBytes(const QByteArray& format = "png");
+
+    /// Number of WebPage objects alive, safe to call from any thread
+    static int instanceCount();
+
 public slots:
     void openUrl(const QString& address, const QVariant& op, const QVariantMap& settings);
     void release();
@@ -278,6 +302,14 @@ public slots:
      */
     QObject* getPage(const QString& windowName) const;
 
+    /**
+     * Sets all the counters of <code>"page.networkStats"</code> back to zero.
+     * Requests still in flight are counted when they finish.
+     *
+     * @brief resetNetworkStats
+     */
+    void resetNetworkStats();
+
     /**
      * Returns the number of Child Frames inside the Current Frame.
      * NOTE: The Current Frame changes when focus moves (via API or JS) to a specific child frame.
@@ -499,6 +531,9 @@ signals:
     void rawPageCreated(QObject* page);
     void closing(QObject* page);
     void repaintRequested(const int x, const int y, const int width, const int height);
+    void downloadStarted(const QVariant& download);
+    void downloadProgress(const QVariant& download);
+    void downloadFinished(const QVariant& download);
 
 private slots:
     void finish(bool ok);
@@ -530,6 +565,7 @@ private:
 private:
     CustomPage* m_customWebPage;
     NetworkAccessManager* m_networkAccessManager;
+    DownloadManager* m_downloadManager;
     QWebFrame* m_mainFrame;
     QWebFrame* m_currentFrame;
     QRect m_clipRect;
@@ -34,15 +34,26 @@
 #include "encoding.h"
 #include "mongoose/mongoose.h"
 #include "consts.h"
+#include "webpage.h"
+#include "utils.h"
 
 #include <QByteArray>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
 #include <QHostAddress>
 #include <QMetaType>
+#include <QSocketNotifier>
+#include <QTemporaryFile>
 #include <QThread>
+#include <QTimer>
 #include <QUrl>
 #include <QVector>
 #include <QDebug>
 
+#include <zlib.h>
+
 namespace UrlEncodedParser
 {
 
@@ -82,6 +93,140 @@ QVariantMap parse(const QByteArray& data)
 
 }
 
+// Request bodies larger than this are spooled to a temporary file (unless set with listen())
+const qint64 DEFAULT_MAX_INLINE_BODY_SIZE = 1024 * 1024;
+// Size of the chunks a request body is read in
+const int REQUEST_BODY_BUFFER_SIZE = 64 * 1024;
+// Block size used by WebServerResponse::writeFile()
+const int RESPONSE_FILE_BUFFER_SIZE = 64 * 1024;
+// Chunks up to this size are copied together with their framing into a single send()
+const int CHUNK_COALESCE_SIZE = 16 * 1024;
+// Responses smaller than this are not compressed (unless set with listen())
+const qint64 DEFAULT_COMPRESSION_MIN_SIZE = 1024;
+// Granularity of the output buffer of ResponseCompressor
+const int COMPRESSION_BUFFER_SIZE = 16 * 1024;
+// How often the main thread reports that its event loop is alive, in ms
+const int HEARTBEAT_INTERVAL = 100;
+// Event loop lag, in ms, above which readinessPath reports the server as busy
+const qint64 DEFAULT_READINESS_MAX_LAG = 1000;
+// Size of the reads from event stream and WebSocket connections
+const int SOCKET_READ_SIZE = 16 * 1024;
+// Largest WebSocket message accepted from a client
+const int MAX_WEBSOCKET_MESSAGE_SIZE = 16 * 1024 * 1024;
+// see RFC 6455, section 1.3
+const char WEBSOCKET_GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+// WebSocket frame opcodes, see RFC 6455, section 5.2
+enum {
+    WebSocketContinuation = 0x0,
+    WebSocketText = 0x1,
+    WebSocketBinary = 0x2,
+    WebSocketClose = 0x8,
+    WebSocketPing = 0x9,
+    WebSocketPong = 0xA
+};
+// Longest chunk-size line accepted in a chunked request body
+const int MAX_CHUNK_HEADER_SIZE = 4096;
+
+/**
+ * Reads the body of a request, sent either with a Content-Length
+ * or with "Transfer-Encoding: chunked" (RFC 7230, section 4.1).
+ */
+class RequestBodyReader
+{
+public:
+    RequestBodyReader(mg_connection* conn, qint64 contentLength, bool chunked)
+        : m_conn(conn)
+        , m_remaining(chunked ? 0 : contentLength)
+        , m_chunked(chunked)
+        , m_done(false)
+    {
+    }
+
+    /// @return number of bytes read, 0 at the end of the body, -1 if it is malformed or truncated
+    qint64 read(char* data, qint64 maxSize)
+    {
+        if (m_done) {
+            return 0;
+        }
+
+        if (!m_chunked) {
+            if (m_remaining <= 0) {
+                m_done = true;
+                return 0;
+            }
+            const int bytesRead = mg_read(m_conn, data, qMin(maxSize, m_remaining));
+            if (bytesRead <= 0) {
+                return -1;
+            }
+            m_remaining -= bytesRead;
+            return bytesRead;
+        }
+
+        if (m_remaining == 0) {
+            // Beginning of a chunk: "size[;extensions]"
+            QByteArray line;
+            if (!readLine(&line)) {
+                return -1;
+            }
+            bool ok = false;
+            m_remaining = line.left(line.indexOf(';')).trimmed().toLongLong(&ok, 16);
+            if (!ok || m_remaining < 0) {
+                return -1;
+            }
+            if (m_remaining == 0) {
+                // Last chunk: skip the trailers, up to an empty line
+                do {
+                    if (!readLine(&line)) {
+                        return -1;
+                    }
+                } while (!line.isEmpty());
+                m_done = true;
+                return 0;
+            }
+        }
+
+        const int bytesRead = mg_read_some(m_conn, data, qMin(maxSize, m_remaining));
+        if (bytesRead <= 0) {
+            return -1;
+        }
+        m_remaining -= bytesRead;
+
+        // Every chunk ends with CRLF
+        QByteArray line;
+        if (m_remaining == 0 && (!readLine(&line) || !line.isEmpty())) {
+            return -1;
+        }
+        return bytesRead;
+    }
+
+private:
+    // Reads byte by byte so that nothing after the body is consumed
+    bool readLine(QByteArray* line)
+    {
+        line->clear();
+        char c;
+        while (line->size() < MAX_CHUNK_HEADER_SIZE) {
+            if (mg_read_some(m_conn, &c, 1) != 1) {
+                return false;
+            }
+            if (c == '\n') {
+                if (line->endsWith('\r')) {
+                    line->chop(1);
+                }
+                return true;
+            }
+            line->append(c);
+        }
+        return false;
+    }
+
+    mg_connection* m_conn;
+    qint64 m_remaining;
+    bool m_chunked;
+    bool m_done;
+};
+
 static void* callback(mg_event event,
                       mg_connection* conn,
                       const mg_request_info* request)
@@ -98,8 +243,16 @@ static void* callback(mg_event event,
 WebServer::WebServer(QObject* parent)
     : QObject(parent)
     , m_ctx(0)
+    , m_maxInlineBodySize(DEFAULT_MAX_INLINE_BODY_SIZE)
+    , m_compressionLevel(0)
+    , m_compressionMinSize(DEFAULT_COMPRESSION_MIN_SIZE)
+    , m_readinessMaxLag(DEFAULT_READINESS_MAX_LAG)
+    , m_heartbeatTimer(new QTimer(this))
 {
     setObjectName("WebServer");
+    m_clock.start();
+    m_heartbeatTimer->setInterval(HEARTBEAT_INTERVAL);
+    connect(m_heartbeatTimer, SIGNAL(timeout()), this, SLOT(heartbeat()));
     qRegisterMetaType<WebServerResponse*>("WebServerResponse*");
 }
 
@@ -111,19 +264,93 @@ WebServer::~WebServer()
 bool WebServer::listenOnPort(const QString& port, const QVariantMap& opts)
 {
     close();
+    m_closing = 0;
+
+    // Tuning options, forwarded to mongoose when set to a positive number
+    static const struct {
+        const char* name;
+        const char* mongooseName;
+    } numericOptions[] = {
+        { "numThreads", "num_threads" },
+        { "maxRequestSize", "max_request_size" },
+        { "backlog", "listen_backlog" },
+        { "keepAliveTimeout", "keep_alive_timeout_ms" }
+    };
 
-    // Create options vector
+    // Create options vector (mongoose copies the values)
+    const QByteArray listeningPorts = port.toLatin1();
+    QList<QByteArray> values;
     QVector<const char*> options;
-    options <<  "listening_ports" << qstrdup(qPrintable(port));
+    options << "listening_ports" << listeningPorts.constData();
     options << "enable_directory_listing" << "no";
     if (opts.value("keepAlive", false).toBool()) {
         options << "enable_keep_alive" << "yes";
     }
+    for (uint i = 0; i < sizeof(numericOptions) / sizeof(numericOptions[0]); ++i) {
+        if (!opts.contains(numericOptions[i].name)) {
+            continue;
+        }
+        bool ok = false;
+        const int value = opts.value(numericOptions[i].name).toInt(&ok);
+        if (!ok || value <= 0) {
+            qWarning() << "WebServer - Invalid value for option" << numericOptions[i].name;
+            return false;
+        }
+        values << QByteArray::number(value);
+        options << numericOptions[i].mongooseName << values.last().constData();
+    }
     options << NULL;
 
+    m_maxInlineBodySize = DEFAULT_MAX_INLINE_BODY_SIZE;
+    if (opts.contains("maxInlineBodySize")) {
+        bool ok = false;
+        m_maxInlineBodySize = opts.value("maxInlineBodySize").toLongLong(&ok);
+        if (!ok || m_maxInlineBodySize < 0) {
+            qWarning() << "WebServer - Invalid value for option maxInlineBodySize";
+            return false;
+        }
+    }
+
+    m_compressionLevel = 0;
+    if (opts.contains("compressionLevel")) {
+        bool ok = false;
+        m_compressionLevel = opts.value("compressionLevel").toInt(&ok);
+        if (!ok || m_compressionLevel < 0 || m_compressionLevel > 9) {
+            qWarning() << "WebServer - Invalid value for option compressionLevel";
+            return false;
+        }
+    }
+    m_compressionMinSize = DEFAULT_COMPRESSION_MIN_SIZE;
+    if (opts.contains("compressionMinSize")) {
+        bool ok = false;
+        m_compressionMinSize = opts.value("compressionMinSize").toLongLong(&ok);
+        if (!ok || m_compressionMinSize < 0) {
+            qWarning() << "WebServer - Invalid value for option compressionMinSize";
+            return false;
+        }
+    }
+
+    m_livenessPath = opts.value("livenessPath").toString().toUtf8();
+    m_readinessPath = opts.value("readinessPath").toString().toUtf8();
+    m_metricsPath = opts.value("metricsPath").toString().toUtf8();
+    m_readinessMaxLag = DEFAULT_READINESS_MAX_LAG;
+    if (opts.contains("readinessMaxLag")) {
+        bool ok = false;
+        m_readinessMaxLag = opts.value("readinessMaxLag").toLongLong(&ok);
+        if (!ok || m_readinessMaxLag <= 0) {
+            qWarning() << "WebServer - Invalid value for option readinessMaxLag";
+            return false;
+        }
+    }
+    if (!m_readinessPath.isEmpty() || !m_metricsPath.isEmpty()) {
+        heartbeat();
+        m_heartbeatTimer->start();
+    }
+
     // Start the server
     m_ctx = mg_start(&callback, this, options.data());
     if (!m_ctx) {
+        m_heartbeatTimer->stop();
         return false;
     }
 
@@ -136,22 +363,238 @@ QString WebServer::port() const
     return m_port;
 }
 
+void WebServer::heartbeat()
+{
+    m_lastHeartbeat.store(m_clock.elapsed());
+}
+
+qint64 WebServer::eventLoopLag() const
+{
+    return qMax(Q_INT64_C(0), m_clock.elapsed() - m_lastHeartbeat.load() - HEARTBEAT_INTERVAL);
+}
+
+static void sendNativeResponse(mg_connection* conn, const mg_request_info* request, int status,
+                               const char* contentType, const QByteArray& body)
+{
+    mg_printf(conn,
+              "HTTP/1.1 %d %s\r\n"
+              "Content-Type: %s\r\n"
+              "Content-Length: %d\r\n"
+              "Cache-Control: no-store\r\n"
+              "\r\n",
+              status, status == 200 ? "OK" : "Service Unavailable", contentType, body.size());
+    if (qstrcmp(request->request_method, "HEAD")) {
+        mg_write(conn, body.constData(), body.size());
+    }
+}
+
+static void appendMetric(QByteArray& out, const char* name, const char* type,
+                         const char* help, const QByteArray& value)
+{
+    out += QByteArray("# HELP ") + name + ' ' + help + '\n';
+    out += QByteArray("# TYPE ") + name + ' ' + type + '\n';
+    out += QByteArray(name) + ' ' + value + '\n';
+}
+
+bool WebServer::serveNativeRoute(mg_connection* conn, const mg_request_info* request)
+{
+    if (qstrcmp(request->request_method, "GET") && qstrcmp(request->request_method, "HEAD")) {
+        return false;
+    }
+
+    const QByteArray uri(request->uri);
+    if (uri.isEmpty()) {
+        return false;
+    }
+
+    if (uri == m_livenessPath) {
+        sendNativeResponse(conn, request, 200, "text/plain", "ok\n");
+        return true;
+    }
+
+    if (uri == m_readinessPath) {
+        const bool ready = !m_closing.loadAcquire() && eventLoopLag() <= m_readinessMaxLag;
+        sendNativeResponse(conn, request, ready ? 200 : 503, "text/plain",
+                           ready ? "ready\n" : "busy\n");
+        return true;
+    }
+
+    if (uri == m_metricsPath) {
+        int pendingResponses;
+        {
+            QMutexLocker lock(&m_mutex);
+            pendingResponses = m_pendingResponses.size();
+        }
+        QByteArray metrics;
+        appendMetric(metrics, "phantomjs_web_pages", "gauge",
+                     "Number of web pages alive.",
+                     QByteArray::number(WebPage::instanceCount()));
+        appendMetric(metrics, "phantomjs_webserver_pending_responses", "gauge",
+                     "Requests handed to the script and not closed yet.",
+                     QByteArray::number(pendingResponses));
+        const qint64 rss = Utils::residentMemorySize();
+        if (rss >= 0) {
+            appendMetric(metrics, "process_resident_memory_bytes", "gauge",
+                         "Resident memory size in bytes.",
+                         QByteArray::number(rss));
+        }
+        appendMetric(metrics, "phantomjs_event_loop_lag_seconds", "gauge",
+                     "How late the main event loop is running.",
+                     QByteArray::number(eventLoopLag() / 1000.0));
+        sendNativeResponse(conn, request, 200, "text/plain; version=0.0.4", metrics);
+        return true;
+    }
+
+    return false;
+}
+
+int WebServer::compressionLevel() const
+{
+    return m_compressionLevel;
+}
+
+qint64 WebServer::compressionMinSize() const
+{
+    return m_compressionMinSize;
+}
+
+static QByteArray normalizedUrlPrefix(const QString& urlPrefix)
+{
+    QByteArray prefix = urlPrefix.toUtf8();
+    if (!prefix.startsWith('/')) {
+        prefix.prepend('/');
+    }
+    while (prefix.endsWith('/')) {
+        prefix.chop(1);
+    }
+    return prefix;
+}
+
+bool WebServer::mount(const QString& urlPrefix, const QString& directory)
+{
+    QFileInfo info(directory);
+    if (!info.isDir()) {
+        qWarning() << "WebServer - Cannot mount" << directory << "- not a directory";
+        return false;
+    }
+
+    StaticMount mount;
+    mount.urlPrefix = normalizedUrlPrefix(urlPrefix);
+    mount.directory = info.canonicalFilePath();
+
+    QWriteLocker lock(&m_mountsLock);
+    for (int i = 0; i < m_mounts.size(); ++i) {
+        if (m_mounts.at(i).urlPrefix == mount.urlPrefix) {
+            m_mounts.removeAt(i);
+            break;
+        }
+    }
+    // Keep the longest prefixes first, so that the first match is the best one
+    int i = 0;
+    while (i < m_mounts.size() && m_mounts.at(i).urlPrefix.size() >= mount.urlPrefix.size()) {
+        ++i;
+    }
+    m_mounts.insert(i, mount);
+    return true;
+}
+
+bool WebServer::unmount(const QString& urlPrefix)
+{
+    const QByteArray prefix = normalizedUrlPrefix(urlPrefix);
+
+    QWriteLocker lock(&m_mountsLock);
+    for (int i = 0; i < m_mounts.size(); ++i) {
+        if (m_mounts.at(i).urlPrefix == prefix) {
+            m_mounts.removeAt(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool WebServer::serveStaticFile(mg_connection* conn, const mg_request_info* request)
+{
+    if (qstrcmp(request->request_method, "GET") && qstrcmp(request->request_method, "HEAD")) {
+        return false;
+    }
+
+    // mongoose has already decoded the URI and removed any ".." from it
+    const QByteArray uri(request->uri);
+    QString path;
+    {
+        QReadLocker lock(&m_mountsLock);
+        foreach(const StaticMount & mount, m_mounts) {
+            if (uri.startsWith(mount.urlPrefix)
+                    && (uri.size() == mount.urlPrefix.size() || uri.at(mount.urlPrefix.size()) == '/')) {
+                path = QDir::cleanPath(mount.directory + QFile::decodeName(uri.mid(mount.urlPrefix.size())));
+                if (path != mount.directory && !path.startsWith(mount.directory + '/')) {
+                    path.clear();
+                }
+                // Symlinks inside the mount must not lead outside of it either
+                const QString canonicalPath = QFileInfo(path).canonicalFilePath();
+                if (!canonicalPath.isEmpty() && canonicalPath != mount.directory
+                        && !canonicalPath.startsWith(mount.directory + '/')) {
+                    path.clear();
+                }
+                break;
+            }
+        }
+    }
+    if (path.isEmpty()) {
+        return false;
+    }
+
+    const int status = mg_send_file(conn, QFile::encodeName(QDir::toNativeSeparators(path)).constData());
+    phantomDebug() << "HTTP Request - Static file" << path << status;
+    return true;
+}
+
 void WebServer::close()
 {
     if (m_ctx) {
         m_closing = 1;
+        QList<WebServerResponse*> pendingResponses;
         {
-            // make sure we wake up all pending responses, such that mg_stop()
-            // can be called without deadlocking
             QMutexLocker lock(&m_mutex);
-            foreach(WebServerResponse * response, m_pendingResponses) {
-                response->close();
-            }
+            pendingResponses = m_pendingResponses;
+            m_pendingResponses.clear();
+        }
+        // detached connections are not known to mongoose: close them before it goes away
+        foreach(WebServerResponse * response, pendingResponses) {
+            response->abortConnection();
         }
         mg_stop(m_ctx);
         m_ctx = 0;
         m_port.clear();
     }
+    m_heartbeatTimer->stop();
+}
+
+// Close the connection once the response is written. Mongoose would keep it
+// alive as the request asked, and parse whatever follows as the next request.
+static void closeConnection(mg_connection* conn)
+{
+    mg_connection* detached = mg_detach(conn);
+    if (!detached) {
+        qWarning() << "HTTP Request - Unable to close the connection";
+        return;
+    }
+    mg_close_detached(detached, 0);
+}
+
+// QByteArray::toPercentEncoding() always makes a copy: skip it when nothing needs encoding
+static QByteArray percentEncoded(const char* text, const char* exclude)
+{
+    const QByteArray bytes(text);
+    for (int i = 0; i < bytes.size(); ++i) {
+        const char c = bytes.at(i);
+        const bool unreserved = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+                                || (c >= '0' && c <= '9') || c == '-' || c == '.' || c == '_' || c == '~';
+        if (!unreserved && !strchr(exclude, c)) {
+            return bytes.toPercentEncoding(exclude);
+        }
+    }
+    return bytes;
 }
 
 bool WebServer::handleRequest(mg_event event, mg_connection* conn, const mg_request_info* request)
@@ -164,13 +607,17 @@ bool WebServer::handleRequest(mg_event event, mg_connection* conn, const mg_requ
         return false;
     }
 
+    if (serveNativeRoute(conn, request) || serveStaticFile(conn, request)) {
+        return true;
+    }
+
     // Modelled after http://nodejs.org/docs/latest/api/http.html#http.ServerRequest
     QVariantMap requestObject;
 
-    qDebug() << "HTTP Request - URI" << request->uri;
-    qDebug() << "HTTP Request - Method" << request->request_method;
-    qDebug() << "HTTP Request - HTTP Version" << request->http_version;
-    qDebug() << "HTTP Request - Query String" << request->query_string;
+    phantomDebug() << "HTTP Request - URI" << request->uri;
+    phantomDebug() << "HTTP Request - Method" << request->request_method;
+    phantomDebug() << "HTTP Request - HTTP Version" << request->http_version;
+    phantomDebug() << "HTTP Request - Query String" << request->query_string;
 
     // Presumably we would not have gotten this far if the
     // request_method or http_version were syntactically invalid.
@@ -202,13 +649,10 @@ bool WebServer::handleRequest(mg_event event, mg_connection* conn, const mg_requ
     // the gen-delims and sub-delims, only '?' and '#' should be
     // force-encoded in ->uri, and only '#' should be force-encoded
     // in ->query_string.)
-    QByteArray uri(request->uri);
-    uri = uri.toPercentEncoding(/*exclude=*/ "!$&'()*+,;=:/[]@");
+    QByteArray uri = percentEncoded(request->uri, /*exclude=*/ "!$&'()*+,;=:/[]@");
     if (request->query_string) {
-        QByteArray qs(request->query_string);
-        qs = qs.toPercentEncoding(/*exclude=*/ "!$&'()*+,;=:/[]@?");
         uri.append('?');
-        uri.append(qs);
+        uri.append(percentEncoded(request->query_string, /*exclude=*/ "!$&'()*+,;=:/[]@?"));
     }
     requestObject["url"] = uri.data();
 
@@ -223,93 +667,265 @@ bool WebServer::handleRequest(mg_event event, mg_connection* conn, const mg_requ
 #endif
 
     QVariantMap headersObject;
-    QMap<QString, QString> ciHeadersObject;               //< FIXME: "case-insensitive" Headers. This shows how desperately we need a better HTTP Server
     for (int i = 0; i < request->num_headers; ++i) {
         QString key = QString::fromLocal8Bit(request->http_headers[i].name);
         QString value = QString::fromLocal8Bit(request->http_headers[i].value);
-        qDebug() << "HTTP Request - Receiving Header" << key << "=" << value;
-        headersObject[key] = value;
-        ciHeadersObject[key.toLower()] = value;
+        phantomDebug() << "HTTP Request - Receiving Header" << key << "=" << value;
+        headersObject.insert(key, value);
     }
     requestObject["headers"] = headersObject;
 
-    // Read request body ONLY for POST and PUT, and ONLY if the "Content-Length" is provided
-    if ((requestObject["method"] == "POST" || requestObject["method"] == "PUT") && ciHeadersObject.contains(HTTP_HEADER_CONTENT_LENGTH)) {
-        bool contentLengthKnown = false;
-        uint contentLength = ciHeadersObject[HTTP_HEADER_CONTENT_LENGTH].toUInt(&contentLengthKnown);
+    // Read request body ONLY for POST and PUT, and ONLY if its length is known:
+    // either from "Content-Length" or because it is chunked.
+    // mg_get_header() looks the headers up case-insensitively, without copying them.
+    QTemporaryFile* spool = 0;
+    const char* transferEncoding = mg_get_header(conn, "Transfer-Encoding");
+    const char* contentLengthHeader = mg_get_header(conn, "Content-Length");
+    const bool chunked = transferEncoding && QByteArray(transferEncoding).toLower().contains("chunked");
+    if ((!qstrcmp(request->request_method, "POST") || !qstrcmp(request->request_method, "PUT")) &&
+            (chunked || contentLengthHeader)) {
+        bool contentLengthKnown = chunked;
+        const qint64 contentLength = chunked ? -1 : QByteArray(contentLengthHeader).trimmed().toLongLong(&contentLengthKnown);
 
-        qDebug() << "HTTP Request - Method POST/PUT";
+        phantomDebug() << "HTTP Request - Method POST/PUT";
 
         // Proceed only if we were able to read the "Content-Length"
         if (contentLengthKnown) {
-            ++contentLength; //< make space for null termination
-            char* data = new char[contentLength];
-            int read = mg_read(conn, data, contentLength);
-            data[read] = '\0'; //< adding null termination (no arm if it's already there)
+            // Small bodies are handed to the script as strings, larger ones
+            // are written to a temporary file as they arrive
+            RequestBodyReader reader(conn, contentLength, chunked);
+            QByteArray buffer(REQUEST_BODY_BUFFER_SIZE, Qt::Uninitialized);
+            QByteArray data;
+            qint64 size = 0;
+            qint64 bytesRead;
+            bool ok = true;
+            while (ok && (bytesRead = reader.read(buffer.data(), buffer.size())) > 0) {
+                size += bytesRead;
+                if (!spool && size > m_maxInlineBodySize) {
+                    spool = new QTemporaryFile(QDir::tempPath() + "/phantomjs-request-XXXXXX");
+                    ok = spool->open() && spool->write(data) == data.size();
+                    data.clear();
+                }
+                if (spool) {
+                    ok = ok && spool->write(buffer.constData(), bytesRead) == bytesRead;
+                } else {
+                    data.append(buffer.constData(), bytesRead);
+                }
+            }
+
+            if (!ok || bytesRead < 0) {
+                qWarning() << "HTTP Request - Failed to read the body";
+                delete spool;
+                mg_printf(conn, "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+                closeConnection(conn);
+                return true;
+            }
 
-            qDebug() << "HTTP Request - Content Body:" << qPrintable(data);
+            phantomDebug() << "HTTP Request - Content Body:" << size << "bytes";
 
-            // Check if the 'Content-Type' requires decoding
-            if (ciHeadersObject[HTTP_HEADER_CONTENT_TYPE] == "application/x-www-form-urlencoded") {
-                requestObject["post"] = UrlEncodedParser::parse(QByteArray(data, read));
-                requestObject["postRaw"] = QString::fromUtf8(data, read);
+            if (spool) {
+                spool->close();
+                requestObject["postFile"] = spool->fileName();
+                requestObject["postSize"] = size;
+            } else if (!qstrcmp(mg_get_header(conn, "Content-Type"), "application/x-www-form-urlencoded")) {
+                // Check if the 'Content-Type' requires decoding
+                requestObject["post"] = UrlEncodedParser::parse(data);
+                requestObject["postRaw"] = QString::fromUtf8(data);
             } else {
-                requestObject["post"] = QString::fromUtf8(data, read);
+                requestObject["post"] = QString::fromUtf8(data);
             }
-            delete[] data;
         } else {
             qWarning() << "HTTP Request - Malformed 'Content-Length'";
         }
     }
 
     // Emit signal that is catched by the PhantomJS callback,
-    // then wait until response.close() was called from
-    // the PhantomJS script.
+    // and give the connection to the response object, so that
+    // this worker thread is free for the next request while
+    // the PhantomJS script prepares the response.
     //
-    // This is achieved using the wait semaphore, which is
-    // acquired here, in the background thread, and released
-    // in WebServerResponse::close() i.e. the foreground thread
-    QSemaphore wait;
-    WebServerResponse responseObject(conn, &wait);
-    responseObject.moveToThread(thread());
-
+    // The connection is released in WebServerResponse::close(),
+    // i.e. in the foreground thread.
     {
-        if (m_closing.loadAcquire()) {
-            return false;
-        }
         QMutexLocker lock(&m_mutex);
-        if (m_closing.loadAcquire()) {
-            return false;
+        mg_connection* detached = m_closing.loadAcquire() ? 0 : mg_detach(conn);
+        if (!detached) {
+            // Returning false would let mongoose serve the request from its document root
+            delete spool;
+            mg_printf(conn, "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            return true;
         }
-        m_pendingResponses << (&responseObject);
-    }
-    newRequest(requestObject, &responseObject);
-    wait.acquire();
-    {
-        if (m_closing.loadAcquire()) {
-            return false;
+        WebServerResponse* responseObject = new WebServerResponse(detached, request, this);
+        if (spool) {
+            // The spooled body is removed together with the response
+            spool->setParent(responseObject);
         }
-        QMutexLocker lock(&m_mutex);
-        if (m_closing.loadAcquire()) {
-            return false;
-        }
-        m_pendingResponses.removeOne(&responseObject);
+        responseObject->moveToThread(thread());
+        m_pendingResponses << responseObject;
+        emit newRequest(requestObject, responseObject);
     }
     return true;
 }
 
+bool WebServer::releaseResponse(WebServerResponse* response)
+{
+    QMutexLocker lock(&m_mutex);
+    return m_pendingResponses.removeOne(response) && !m_closing.loadAcquire();
+}
+
+
+//BEGIN ResponseCompressor
+
+/**
+ * Incremental gzip or deflate encoder for response bodies.
+ */
+class ResponseCompressor
+{
+public:
+    ResponseCompressor()
+        : m_initialized(false)
+    {
+        memset(&m_stream, 0, sizeof(m_stream));
+    }
+
+    ~ResponseCompressor()
+    {
+        if (m_initialized) {
+            deflateEnd(&m_stream);
+        }
+    }
+
+    bool init(bool gzip, int level)
+    {
+        // 15 + 16 asks zlib for a gzip wrapper instead of the zlib one
+        m_initialized = deflateInit2(&m_stream, level, Z_DEFLATED, gzip ? 15 + 16 : 15,
+                                     8, Z_DEFAULT_STRATEGY) == Z_OK;
+        return m_initialized;
+    }
+
+    /**
+     * Compress @p size bytes at @p data, and flush the output so that the
+     * client can decode everything written so far.
+     *
+     * If @p finish is true, the stream is terminated instead.
+     */
+    QByteArray compress(const char* data, qint64 size, bool finish)
+    {
+        QByteArray out;
+        m_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        m_stream.avail_in = static_cast<uInt>(size);
+        int ret;
+        do {
+            const int offset = out.size();
+            out.resize(offset + COMPRESSION_BUFFER_SIZE);
+            m_stream.next_out = reinterpret_cast<Bytef*>(out.data() + offset);
+            m_stream.avail_out = COMPRESSION_BUFFER_SIZE;
+            ret = deflate(&m_stream, finish ? Z_FINISH : Z_SYNC_FLUSH);
+            out.resize(out.size() - m_stream.avail_out);
+        } while (ret == Z_OK && m_stream.avail_out == 0);
+        return out;
+    }
+
+private:
+    z_stream m_stream;
+    bool m_initialized;
+};
+
+//END ResponseCompressor
 
 //BEGIN WebServerResponse
 
-WebServerResponse::WebServerResponse(mg_connection* conn, QSemaphore* close)
+WebServerResponse::WebServerResponse(mg_connection* conn, const mg_request_info* request, WebServer* server)
     : QObject()
     , m_conn(conn)
     , m_statusCode(200)
     , m_headersSent(false)
-    , m_close(close)
+    , m_headRequest(!qstrcmp(request->request_method, "HEAD"))
+    , m_http11(!qstrcmp(request->http_version, "1.1"))
+    , m_chunked(false)
+    , m_delimited(false)
+    , m_headDeferred(false)
+    , m_coding(IdentityCoding)
+    , m_compressionLevel(server->compressionLevel())
+    , m_compressionMinSize(server->compressionMinSize())
+    , m_eventStream(false)
+    , m_webSocket(false)
+    , m_socketNotifier(0)
+    , m_fragmentedOpcode(WebSocketContinuation)
+    , m_outputEncoding(Utf8Output)
+    , m_server(server)
+{
+    if (m_compressionLevel > 0) {
+        m_coding = acceptedCoding(mg_get_header(conn, "Accept-Encoding"));
+    }
+}
+
+WebServerResponse::~WebServerResponse()
 {
 }
 
+WebServerResponse::ContentCoding WebServerResponse::acceptedCoding(const char* acceptEncoding)
+{
+    bool gzip = false;
+    bool deflate = false;
+    foreach(const QByteArray & entry, QByteArray(acceptEncoding).split(',')) {
+        // e.g. "gzip;q=0.8"
+        const QList<QByteArray> parts = entry.split(';');
+        const QByteArray coding = parts.first().trimmed().toLower();
+        double quality = 1;
+        for (int i = 1; i < parts.size(); ++i) {
+            const QByteArray param = parts.at(i).trimmed();
+            if (param.startsWith("q=")) {
+                quality = param.mid(2).toDouble();
+            }
+        }
+        if (quality <= 0) {
+            continue;
+        }
+        if (coding == "gzip" || coding == "x-gzip" || coding == "*") {
+            gzip = true;
+        } else if (coding == "deflate") {
+            deflate = true;
+        }
+    }
+    return gzip ? GzipCoding : deflate ? DeflateCoding : IdentityCoding;
+}
+
+static QVariant headerValue(const QVariantMap& headers, const char* name)
+{
+    QVariantMap::const_iterator it = headers.constBegin();
+    for (; it != headers.constEnd(); ++it) {
+        if (!it.key().compare(QLatin1String(name), Qt::CaseInsensitive)) {
+            return it.value();
+        }
+    }
+    return QVariant();
+}
+
+static void removeHeader(QVariantMap& headers, const char* name)
+{
+    QVariantMap::iterator it = headers.begin();
+    while (it != headers.end()) {
+        if (!it.key().compare(QLatin1String(name), Qt::CaseInsensitive)) {
+            it = headers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+static bool isCompressibleType(const QString& contentType)
+{
+    if (contentType.startsWith("text/event-stream", Qt::CaseInsensitive)) {
+        // would be held back until compressionMinSize bytes of events are sent
+        return false;
+    }
+    return contentType.startsWith("text/", Qt::CaseInsensitive)
+           || contentType.contains("json", Qt::CaseInsensitive)
+           || contentType.contains("javascript", Qt::CaseInsensitive)
+           || contentType.contains("xml", Qt::CaseInsensitive);
+}
+
 const char* responseCodeString(int code)
 {
     // see: http://www.w3.org/Protocols/rfc2616/rfc2616-sec10.html
@@ -406,46 +1022,520 @@ void WebServerResponse::writeHead(int statusCode, const QVariantMap& headers)
     ///TODO: what is the best-practice error handling in javascript? exceptions?
     Q_ASSERT(!m_headersSent);
     m_headersSent = true;
+    if (!m_conn) {
+        return;
+    }
     m_statusCode = statusCode;
+
+    if (m_coding != IdentityCoding && hasBody() && m_http11
+            && headerValue(headers, "Content-Encoding").isNull()
+            && headerValue(headers, "Transfer-Encoding").isNull()
+            && isCompressibleType(headerValue(headers, "Content-Type").toString())) {
+        const QVariant length = headerValue(headers, "Content-Length");
+        if (length.isNull()) {
+            // Hold the headers back until there is enough body to know whether to compress it
+            m_deferredHeaders = headers;
+            m_headDeferred = true;
+            return;
+        }
+        if (length.toLongLong() >= m_compressionMinSize) {
+            startCompression(headers);
+            return;
+        }
+    }
+    sendHead(headers);
+}
+
+bool WebServerResponse::hasBody() const
+{
+    return !m_headRequest && m_statusCode >= 200 && m_statusCode != 204 && m_statusCode != 304;
+}
+
+void WebServerResponse::startCompression(QVariantMap headers)
+{
+    m_compressor.reset(new ResponseCompressor);
+    if (!m_compressor->init(m_coding == GzipCoding, m_compressionLevel)) {
+        qWarning() << "WebServerResponse - Unable to initialize compression";
+        m_compressor.reset();
+        sendHead(headers);
+        return;
+    }
+
+    // The compressed length is not known up front: the body is sent in chunks
+    removeHeader(headers, "Content-Length");
+    headers["Content-Encoding"] = m_coding == GzipCoding ? "gzip" : "deflate";
+    const QString vary = headerValue(headers, "Vary").toString();
+    removeHeader(headers, "Vary");
+    headers["Vary"] = vary.isEmpty() ? QString("Accept-Encoding") : vary + ", Accept-Encoding";
+    sendHead(headers);
+}
+
+void WebServerResponse::sendHead(const QVariantMap& headers)
+{
     mg_printf(m_conn, "HTTP/1.1 %d %s\r\n", m_statusCode, responseCodeString(m_statusCode));
-    qDebug() << "HTTP Response - Status Code" << m_statusCode << responseCodeString(m_statusCode);
+    phantomDebug() << "HTTP Response - Status Code" << m_statusCode << responseCodeString(m_statusCode);
+    bool hasContentLength = false;
+    bool hasTransferEncoding = false;
     QVariantMap::const_iterator it = headers.constBegin();
     while (it != headers.constEnd()) {
-        qDebug() << "HTTP Response - Sending Header" << it.key() << "=" << it.value().toString();
+        phantomDebug() << "HTTP Response - Sending Header" << it.key() << "=" << it.value().toString();
         mg_printf(m_conn, "%s: %s\r\n", qPrintable(it.key()), qPrintable(it.value().toString()));
+        if (!it.key().compare("Content-Length", Qt::CaseInsensitive)) {
+            hasContentLength = true;
+        } else if (!it.key().compare("Transfer-Encoding", Qt::CaseInsensitive)) {
+            hasTransferEncoding = true;
+        }
         ++it;
     }
+
+    // Without a length, the body is sent in chunks so that every write() reaches
+    // the client right away and the connection can still be kept alive.
+    // Responses that have no body at all need neither.
+    if (hasBody() && !hasContentLength && !hasTransferEncoding && m_http11) {
+        phantomDebug() << "HTTP Response - Sending Header" << "Transfer-Encoding" << "=" << "chunked";
+        mg_printf(m_conn, "Transfer-Encoding: chunked\r\n");
+        m_chunked = true;
+    }
+    m_delimited = m_chunked || hasContentLength || !hasBody();
     mg_write(m_conn, "\r\n", 2);
 }
 
 void WebServerResponse::write(const QVariant& body)
 {
+    if (m_webSocket) {
+        sendMessage(body);
+        return;
+    }
+    if (body.type() == QVariant::ByteArray) {
+        writeBytes(body.toByteArray());
+        return;
+    }
+
+    const QString string = body.toString();
+    switch (m_outputEncoding) {
+    case Utf8Output:
+        writeBytes(string.toUtf8());
+        break;
+    case BinaryOutput:
+        writeBytes(string.toLatin1());
+        break;
+    case CodecOutput:
+        writeBytes(m_encoding.encode(string));
+        break;
+    }
+}
+
+void WebServerResponse::writeBase64(const QString& data)
+{
+    writeBytes(QByteArray::fromBase64(data.toLatin1()));
+}
+
+bool WebServerResponse::writeFile(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "WebServerResponse - Unable to open" << path << "-" << file.errorString();
+        return false;
+    }
+
     if (!m_headersSent) {
         writeHead(m_statusCode, m_headers);
     }
 
-    QByteArray data;
-    if (m_encoding.isEmpty()) {
-        data = body.toString().toUtf8();
-    } else if (m_encoding.toLower() == "binary") {
-        data = body.toString().toLatin1();
-    } else {
-        Encoding encoding;
-        encoding.setEncoding(m_encoding);
-        data = encoding.encode(body.toString());
+    QByteArray buffer(RESPONSE_FILE_BUFFER_SIZE, Qt::Uninitialized);
+    qint64 bytesRead;
+    while ((bytesRead = file.read(buffer.data(), buffer.size())) > 0) {
+        if (!sendBody(buffer.constData(), bytesRead)) {
+            // Client went away, nothing more to do
+            return true;
+        }
+    }
+    return bytesRead == 0;
+}
+
+bool WebServerResponse::writeRender(QObject* page, const QString& format)
+{
+    WebPage* webPage = qobject_cast<WebPage*>(page);
+    if (!webPage) {
+        qWarning() << "WebServerResponse - writeRender() needs a WebPage";
+        return false;
+    }
+
+    const QByteArray image = webPage->renderBytes(format.toLatin1());
+    if (image.isEmpty()) {
+        return false;
+    }
+    writeBytes(image);
+    return true;
+}
+
+void WebServerResponse::writeBytes(const QByteArray& data)
+{
+    if (!m_headersSent) {
+        writeHead(m_statusCode, m_headers);
+    }
+    sendBody(data.constData(), data.size());
+}
+
+bool WebServerResponse::sendBody(const char* data, qint64 size)
+{
+    if (!m_conn) {
+        return false;
+    }
+    if (m_headDeferred) {
+        m_pendingBody.append(data, size);
+        if (m_pendingBody.size() < m_compressionMinSize) {
+            return true;
+        }
+        m_headDeferred = false;
+        startCompression(m_deferredHeaders);
+        m_deferredHeaders.clear();
+        QByteArray pending;
+        pending.swap(m_pendingBody);
+        return sendBody(pending.constData(), pending.size());
+    }
+    if (m_compressor && size > 0) {
+        const QByteArray compressed = m_compressor->compress(data, size, false);
+        return sendChunk(compressed.constData(), compressed.size());
+    }
+    return sendChunk(data, size);
+}
+
+bool WebServerResponse::sendChunk(const char* data, qint64 size)
+{
+    if (!m_chunked) {
+        return mg_write(m_conn, data, size) == size;
+    }
+    if (size == 0) {
+        // an empty chunk would end the body
+        return true;
     }
 
-    mg_write(m_conn, data.constData(), data.size());
+    const QByteArray sizeLine = QByteArray::number(size, 16) + "\r\n";
+    if (size > CHUNK_COALESCE_SIZE) {
+        return mg_write(m_conn, sizeLine.constData(), sizeLine.size()) == sizeLine.size()
+               && mg_write(m_conn, data, size) == size
+               && mg_write(m_conn, "\r\n", 2) == 2;
+    }
+    // Small chunks go out in one send(), as the client may be waiting for each of them
+    QByteArray chunk;
+    chunk.reserve(sizeLine.size() + size + 2);
+    chunk.append(sizeLine).append(data, size).append("\r\n", 2);
+    return mg_write(m_conn, chunk.constData(), chunk.size()) == chunk.size();
 }
 
 void WebServerResponse::setEncoding(const QString& encoding)
 {
-    m_encoding = encoding;
+    if (encoding.isEmpty()) {
+        m_outputEncoding = Utf8Output;
+    } else if (encoding.toLower() == "binary") {
+        m_outputEncoding = BinaryOutput;
+    } else {
+        // Look the codec up once, not for every write()
+        m_outputEncoding = CodecOutput;
+        m_encoding = Encoding();
+        m_encoding.setEncoding(encoding);
+    }
+}
+
+bool WebServerResponse::startEventStream()
+{
+    if (m_eventStream) {
+        return true;
+    }
+    if (m_headersSent || m_webSocket) {
+        return false;
+    }
+
+    m_eventStream = true;
+    removeHeader(m_headers, "Content-Type");
+    removeHeader(m_headers, "Cache-Control");
+    m_headers["Content-Type"] = "text/event-stream; charset=utf-8";
+    m_headers["Cache-Control"] = "no-cache";
+    writeHead(m_statusCode, m_headers);
+    watchSocket();
+    return true;
+}
+
+bool WebServerResponse::sendEvent(const QString& data, const QVariantMap& options)
+{
+    if (!startEventStream() || !m_conn) {
+        return false;
+    }
+
+    // see http://www.w3.org/TR/eventsource/#event-stream-interpretation
+    QByteArray event;
+    if (options.contains("event")) {
+        event += "event: " + options.value("event").toString().toUtf8() + '\n';
+    }
+    if (options.contains("id")) {
+        event += "id: " + options.value("id").toString().toUtf8() + '\n';
+    }
+    if (options.contains("retry")) {
+        event += "retry: " + QByteArray::number(options.value("retry").toInt()) + '\n';
+    }
+    foreach(const QByteArray & line, data.toUtf8().split('\n')) {
+        event += "data: " + line + '\n';
+    }
+    event += '\n';
+
+    if (!sendBody(event.constData(), event.size())) {
+        handleDisconnect();
+        return false;
+    }
+    return true;
+}
+
+bool WebServerResponse::acceptWebSocket(const QString& protocol)
+{
+    if (m_headersSent || !m_conn) {
+        return false;
+    }
+
+    const QByteArray upgrade(mg_get_header(m_conn, "Upgrade"));
+    const QByteArray key(mg_get_header(m_conn, "Sec-WebSocket-Key"));
+    const QByteArray version(mg_get_header(m_conn, "Sec-WebSocket-Version"));
+    if (upgrade.toLower() != "websocket" || key.isEmpty() || version != "13") {
+        qWarning() << "WebServerResponse - Not a WebSocket handshake";
+        return false;
+    }
+
+    const QByteArray accept = QCryptographicHash::hash(key.trimmed() + WEBSOCKET_GUID,
+                              QCryptographicHash::Sha1).toBase64();
+    QByteArray head = "HTTP/1.1 101 Switching Protocols\r\n"
+                      "Upgrade: websocket\r\n"
+                      "Connection: Upgrade\r\n"
+                      "Sec-WebSocket-Accept: " + accept + "\r\n";
+    if (!protocol.isEmpty()) {
+        head += "Sec-WebSocket-Protocol: " + protocol.toUtf8() + "\r\n";
+    }
+    head += "\r\n";
+
+    m_headersSent = true;
+    m_statusCode = 101;
+    m_webSocket = true;
+    if (mg_write(m_conn, head.constData(), head.size()) != head.size()) {
+        handleDisconnect();
+        return false;
+    }
+    watchSocket();
+    return true;
+}
+
+bool WebServerResponse::sendMessage(const QVariant& data)
+{
+    if (!m_webSocket || !m_conn) {
+        return false;
+    }
+    if (data.type() == QVariant::ByteArray) {
+        return sendWebSocketFrame(WebSocketBinary, data.toByteArray());
+    }
+    return sendWebSocketFrame(WebSocketText, data.toString().toUtf8());
+}
+
+bool WebServerResponse::sendWebSocketFrame(int opcode, const QByteArray& payload)
+{
+    if (!m_conn) {
+        return false;
+    }
+
+    // Server frames are never masked, see RFC 6455, section 5.1
+    QByteArray frame;
+    frame.reserve(payload.size() + 10);
+    frame.append(char(0x80 | opcode));
+    const quint64 size = payload.size();
+    if (size < 126) {
+        frame.append(char(size));
+    } else if (size <= 0xFFFF) {
+        frame.append(char(126));
+        frame.append(char(size >> 8)).append(char(size));
+    } else {
+        frame.append(char(127));
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            frame.append(char(size >> shift));
+        }
+    }
+    frame.append(payload);
+
+    if (mg_write(m_conn, frame.constData(), frame.size()) != frame.size()) {
+        handleDisconnect();
+        return false;
+    }
+    return true;
+}
+
+void WebServerResponse::watchSocket()
+{
+    if (!m_conn || m_socketNotifier) {
+        return;
+    }
+    // Nothing is left over from reading the request: WebSocket clients wait
+    // for the handshake to be answered, and SSE clients only ever read
+    // (the notifier then just reports them disconnecting)
+    m_socketNotifier = new QSocketNotifier(mg_get_socket(m_conn), QSocketNotifier::Read, this);
+    connect(m_socketNotifier, SIGNAL(activated(int)), this, SLOT(handleSocketActivity()));
+}
+
+void WebServerResponse::handleSocketActivity()
+{
+    if (!m_conn) {
+        return;
+    }
+
+    QByteArray buffer(SOCKET_READ_SIZE, Qt::Uninitialized);
+    const int bytesRead = mg_read_some(m_conn, buffer.data(), buffer.size());
+    if (bytesRead <= 0) {
+        // The socket became readable, but there is nothing to read: the client is gone
+        handleDisconnect();
+        return;
+    }
+    if (!m_webSocket) {
+        // Event stream clients have nothing to say
+        return;
+    }
+
+    m_incoming.append(buffer.constData(), bytesRead);
+    handleWebSocketFrames();
+}
+
+void WebServerResponse::handleWebSocketFrames()
+{
+    // see RFC 6455, section 5.2
+    while (m_conn && m_incoming.size() >= 2) {
+        const uchar* data = reinterpret_cast<const uchar*>(m_incoming.constData());
+        const bool fin = data[0] & 0x80;
+        const int opcode = data[0] & 0x0F;
+        const bool masked = data[1] & 0x80;
+        quint64 size = data[1] & 0x7F;
+        int headerSize = 2;
+        if (size == 126) {
+            headerSize += 2;
+        } else if (size == 127) {
+            headerSize += 8;
+        }
+        if (m_incoming.size() < headerSize + (masked ? 4 : 0)) {
+            return;
+        }
+        if (size >= 126) {
+            size = 0;
+            for (int i = 2; i < headerSize; ++i) {
+                size = (size << 8) | data[i];
+            }
+        }
+        if (!masked) {
+            failWebSocket(1002);
+            return;
+        }
+        if (size > quint64(MAX_WEBSOCKET_MESSAGE_SIZE)
+                || quint64(m_fragmentedMessage.size()) + size > quint64(MAX_WEBSOCKET_MESSAGE_SIZE)) {
+            failWebSocket(1009);
+            return;
+        }
+        const int frameSize = headerSize + 4 + int(size);
+        if (m_incoming.size() < frameSize) {
+            return;
+        }
+
+        const uchar* mask = data + headerSize;
+        QByteArray payload(m_incoming.constData() + headerSize + 4, int(size));
+        for (int i = 0; i < payload.size(); ++i) {
+            payload[i] = payload.at(i) ^ mask[i % 4];
+        }
+        m_incoming.remove(0, frameSize);
+
+        switch (opcode) {
+        case WebSocketPing:
+            sendWebSocketFrame(WebSocketPong, payload);
+            break;
+        case WebSocketPong:
+            break;
+        case WebSocketClose:
+            // Echo the status code, then we are done
+            sendWebSocketFrame(WebSocketClose, payload.left(2));
+            handleDisconnect();
+            return;
+        case WebSocketText:
+        case WebSocketBinary:
+        case WebSocketContinuation:
+            if (opcode != WebSocketContinuation) {
+                m_fragmentedOpcode = opcode;
+                m_fragmentedMessage = payload;
+            } else {
+                m_fragmentedMessage.append(payload);
+            }
+            if (fin) {
+                const QByteArray complete = m_fragmentedMessage;
+                m_fragmentedMessage.clear();
+                emit message(m_fragmentedOpcode == WebSocketText ? QString::fromUtf8(complete)
+                             : QString::fromLatin1(complete));
+            }
+            break;
+        default:
+            failWebSocket(1002);
+            return;
+        }
+    }
+}
+
+void WebServerResponse::failWebSocket(quint16 code)
+{
+    // 1002: protocol error, 1009: message too big, see RFC 6455, section 7.4.1
+    sendWebSocketFrame(WebSocketClose, QByteArray().append(char(code >> 8)).append(char(code & 0xFF)));
+    handleDisconnect();
+}
+
+void WebServerResponse::handleDisconnect()
+{
+    if (!m_conn) {
+        return;
+    }
+    if (m_socketNotifier) {
+        m_socketNotifier->setEnabled(false);
+    }
+    if (m_server) {
+        m_server->releaseResponse(this);
+    }
+    mg_close_detached(m_conn, 0);
+    m_conn = 0;
+    emit closed();
 }
 
 void WebServerResponse::close()
 {
-    m_close->release();
+    if (m_webSocket && m_conn) {
+        // 1000: normal closure
+        sendWebSocketFrame(WebSocketClose, QByteArray("\x03\xe8", 2));
+    }
+    if (m_conn) {
+        if (m_headDeferred) {
+            // The body stayed below compressionMinSize: send it as it is
+            m_headDeferred = false;
+            m_deferredHeaders["Content-Length"] = m_pendingBody.size();
+            sendHead(m_deferredHeaders);
+            sendChunk(m_pendingBody.constData(), m_pendingBody.size());
+        } else if (m_compressor) {
+            const QByteArray tail = m_compressor->compress(0, 0, true);
+            sendChunk(tail.constData(), tail.size());
+            m_compressor.reset();
+        }
+        if (m_chunked) {
+            mg_write(m_conn, "0\r\n\r\n", 5);
+        }
+        // The client can only tell where the body ends if it was delimited
+        const bool keepAlive = m_server && m_server->releaseResponse(this) && m_delimited
+                               && !m_webSocket && !m_eventStream;
+        mg_close_detached(m_conn, keepAlive);
+        m_conn = 0;
+    }
+    deleteLater();
+}
+
+void WebServerResponse::abortConnection()
+{
+    if (m_conn) {
+        mg_close_detached(m_conn, 0);
+        m_conn = 0;
+    }
 }
 
 void WebServerResponse::closeGracefully()
@@ -33,13 +33,21 @@
 
 #include <QVariantMap>
 #include <QMutex>
-#include <QSemaphore>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QReadWriteLock>
+#include <QScopedPointer>
 
 #include "mongoose.h"
+#include "encoding.h"
 
 class Config;
+class QSocketNotifier;
+class QTimer;
 
 class WebServerResponse;
+class ResponseCompressor;
 
 /**
  * Scriptable HTTP web server.
@@ -62,6 +70,27 @@ public slots:
      * For each new request @c handleRequest() will be called which
      * in turn emits @c newRequest() where appropriate.
      *
+     * Supported @p options:
+     *  - keepAlive: keep connections open between requests
+     *  - numThreads: size of the worker thread pool (default: 10)
+     *  - maxRequestSize: largest request line and headers, in bytes (default: 16384)
+     *  - backlog: length of the queue of connections not yet accepted (default: 20)
+     *  - keepAliveTimeout: ms a connection may stay idle waiting for a request (default: no limit)
+     *  - maxInlineBodySize: bodies up to this size, in bytes, are given to the script as
+     *    request.post; larger ones are saved to the temporary file request.postFile,
+     *    valid until the response is closed (default: 1 MiB)
+     *  - compressionLevel: gzip or deflate level from 1 to 9 for text responses, when the
+     *    client accepts them (default: 0, no compression)
+     *  - compressionMinSize: smallest body, in bytes, worth compressing (default: 1024)
+     *  - livenessPath, readinessPath, metricsPath: URL paths answered by the worker
+     *    threads, without calling the request handler, so that they keep responding
+     *    while the script is busy:
+     *    - liveness always answers 200
+     *    - readiness answers 503 when the event loop lags behind by more than
+     *      readinessMaxLag ms (default: 1000), or when the server is closing
+     *    - metrics reports web pages, pending responses, resident memory and
+     *      event loop lag in the Prometheus text format
+     *
      * @return true if we can listen on @p port, false otherwise.
      *
      * WARNING: must not be the same name as in the javascript api...
@@ -76,6 +105,20 @@ public slots:
     /// Stop listening for incoming connections.
     void close();
 
+    /**
+     * Serve GET and HEAD requests for @p urlPrefix and the paths below it
+     * from the files in @p directory.
+     *
+     * These requests are answered by the worker threads of the server,
+     * without calling the request handler. Other methods are passed on to
+     * the request handler as usual. The longest matching prefix wins.
+     *
+     * @return false if @p directory does not exist.
+     */
+    bool mount(const QString& urlPrefix, const QString& directory);
+    /// Stop serving files for @p urlPrefix, @return false if it was not mounted.
+    bool unmount(const QString& urlPrefix);
+
 signals:
     /// @p request is a WebServerRequest, @p response is a WebServerResponse
     void newRequest(QVariant request, QObject* response);
@@ -83,17 +126,59 @@ signals:
 public:
     bool handleRequest(mg_event event, mg_connection* conn, const mg_request_info* request);
 
+    /// compression settings for responses, see listenOnPort()
+    int compressionLevel() const;
+    qint64 compressionMinSize() const;
+
+    /**
+     * Forget about @p response, which is being closed.
+     *
+     * @return false if the server is closing (or was closed) in the meantime,
+     *         in which case the connection of @p response must not be kept alive.
+     */
+    bool releaseResponse(WebServerResponse* response);
+
+private slots:
+    void heartbeat();
+
 private:
+    bool serveStaticFile(mg_connection* conn, const mg_request_info* request);
+    bool serveNativeRoute(mg_connection* conn, const mg_request_info* request);
+    /// ms the main thread's event loop is running late, safe to call from any thread
+    qint64 eventLoopLag() const;
+
+    struct StaticMount {
+        QByteArray urlPrefix;
+        QString directory;
+    };
+
     mg_context* m_ctx;
     QString m_port;
     QMutex m_mutex;
     QList<WebServerResponse*> m_pendingResponses;
     QAtomicInt m_closing;
+    qint64 m_maxInlineBodySize;
+    int m_compressionLevel;
+    qint64 m_compressionMinSize;
+    QByteArray m_livenessPath;
+    QByteArray m_readinessPath;
+    QByteArray m_metricsPath;
+    qint64 m_readinessMaxLag;
+    QTimer* m_heartbeatTimer;
+    QElapsedTimer m_clock;
+    QAtomicInteger<qint64> m_lastHeartbeat;
+    QReadWriteLock m_mountsLock;
+    QList<StaticMount> m_mounts;
 };
 
 
 /**
  * Outgoing HTTP response to client.
+ *
+ * The connection is detached from the mongoose worker thread that received
+ * the request, so the worker can serve other clients while the script
+ * prepares the response: the number of requests in flight is not bounded
+ * by the number of worker threads.
  */
 class WebServerResponse : public QObject
 {
@@ -102,21 +187,85 @@ class WebServerResponse : public QObject
     Q_PROPERTY(int statusCode READ statusCode WRITE setStatusCode)
     Q_PROPERTY(QVariantMap headers READ headers WRITE setHeaders)
 public:
-    WebServerResponse(mg_connection* conn, QSemaphore* close);
+    WebServerResponse(mg_connection* conn, const mg_request_info* request, WebServer* server);
+    virtual ~WebServerResponse();
 
 public slots:
-    /// send @p headers to client with status code @p statusCode
+    /**
+     * Send @p headers to client with status code @p statusCode.
+     *
+     * Unless @p headers contain a Content-Length (or Transfer-Encoding), the body
+     * is sent with chunked transfer encoding to HTTP/1.1 clients: every write()
+     * is then forwarded to the client immediately, as one chunk.
+     */
     void writeHead(int statusCode, const QVariantMap& headers);
-    /// sends @p data to client and makes sure the headers are send beforehand
+    /**
+     * Sends @p data to client and makes sure the headers are send beforehand.
+     *
+     * Strings are encoded as set with setEncoding() (UTF-8 by default),
+     * byte arrays are sent as they are.
+     */
     void write(const QVariant& data);
+    /// decodes the base-64 string @p data and sends the bytes as they are
+    void writeBase64(const QString& data);
+    /**
+     * Sends the contents of the file at @p path, in blocks, without converting them.
+     *
+     * @return false if the file could not be read
+     */
+    bool writeFile(const QString& path);
+    /**
+     * Renders @p page (a WebPage) as an image in @p format and sends it as it is.
+     *
+     * @return false if @p page is not a WebPage or @p format is not supported
+     */
+    bool writeRender(QObject* page, const QString& format = "png");
     // sets @p as encoding used to output data
     void setEncoding(const QString& encoding);
 
+    /**
+     * Start a Server-Sent Events stream: sends the headers, with
+     * Content-Type text/event-stream, if not done yet.
+     *
+     * The connection stays open until close() is called or the
+     * client goes away, see closed().
+     *
+     * @return false if other headers were sent already
+     */
+    bool startEventStream();
+    /**
+     * Send an event with @p data to the client of an event stream,
+     * starting the stream if needed.
+     *
+     * Supported @p options: event (the event type), id, retry (in ms).
+     *
+     * @return false if the client is gone
+     */
+    bool sendEvent(const QString& data, const QVariantMap& options = QVariantMap());
+
+    /**
+     * Accept the WebSocket upgrade asked for by the request, with
+     * the subprotocol @p protocol if given.
+     *
+     * Messages are then exchanged with sendMessage() and message().
+     *
+     * @return false if the request is not a valid WebSocket handshake
+     *         or headers were sent already
+     */
+    bool acceptWebSocket(const QString& protocol = QString());
+    /**
+     * Send @p data as a WebSocket message: strings as text messages,
+     * byte arrays as binary ones.
+     *
+     * @return false if the client is gone
+     */
+    bool sendMessage(const QVariant& data);
+
     /**
      * Closes the request once all data has been written to the client.
      *
-     * NOTE: This MUST be called, otherwise the server will
-     *       not allow new connections anymore.
+     * NOTE: This MUST be called, otherwise the connection
+     *       (and this object) is never released.
      *
      * NOTE: After calling close(), this request object
      *       is no longer valid. Any further calls are
@@ -142,13 +291,76 @@ public slots:
     /// set all headers
     void setHeaders(const QVariantMap& headers);
 
+signals:
+    /// A WebSocket message from the client: a string for text messages,
+    /// a binary string (one character per byte) for binary ones
+    void message(const QVariant& data);
+    /// The client closed the event stream or WebSocket, close() should still be called
+    void closed();
+
+public:
+    /// Drop the connection without waiting for the script, used when the server is closed
+    void abortConnection();
+
+private slots:
+    void handleSocketActivity();
+
 private:
+    /// sends @p data to client as it is, after the headers
+    void writeBytes(const QByteArray& data);
+    /// sends @p size bytes of body, compressed if needed, @return false on error
+    bool sendBody(const char* data, qint64 size);
+    /// sends @p size bytes, framed as a chunk if needed, @return false on error
+    bool sendChunk(const char* data, qint64 size);
+    /// sends the status line and @p headers
+    void sendHead(const QVariantMap& headers);
+    void startCompression(QVariantMap headers);
+    bool hasBody() const;
+    /// watch the connection for data from the client (or its disconnection)
+    void watchSocket();
+    bool sendWebSocketFrame(int opcode, const QByteArray& payload);
+    void handleWebSocketFrames();
+    /// close the WebSocket with status @p code, after a protocol violation
+    void failWebSocket(quint16 code);
+    void handleDisconnect();
+
+    enum ContentCoding {
+        IdentityCoding,
+        GzipCoding,
+        DeflateCoding
+    };
+    static ContentCoding acceptedCoding(const char* acceptEncoding);
+
+    enum OutputEncoding {
+        Utf8Output,
+        BinaryOutput,
+        CodecOutput
+    };
+
     mg_connection* m_conn;
     int m_statusCode;
     QVariantMap m_headers;
     bool m_headersSent;
-    QString m_encoding;
-    QSemaphore* m_close;
+    bool m_headRequest;
+    bool m_http11;
+    bool m_chunked;
+    bool m_delimited;
+    bool m_headDeferred;
+    QVariantMap m_deferredHeaders;
+    QByteArray m_pendingBody;
+    ContentCoding m_coding;
+    int m_compressionLevel;
+    qint64 m_compressionMinSize;
+    QScopedPointer<ResponseCompressor> m_compressor;
+    bool m_eventStream;
+    bool m_webSocket;
+    QSocketNotifier* m_socketNotifier;
+    QByteArray m_incoming;
+    QByteArray m_fragmentedMessage;
+    int m_fragmentedOpcode;
+    OutputEncoding m_outputEncoding;
+    Encoding m_encoding;
+    QPointer<WebServer> m_server;
 };
 
 #endif // WEBSERVER_H
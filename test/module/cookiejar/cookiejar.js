@@ -90,3 +90,21 @@ test(function () {
     jar2.close();
 
 }, "cookie jar isolation");
+
+test(function () {
+    var original = cookiejar.create();
+    original.addCookie(cookie1);
+    original.addCookie(cookie2);
+
+    var fork = original.fork();
+    assert_equals(fork.cookies.length, 2);
+
+    // Changes to either jar don't show up in the other one
+    fork.deleteCookie('Valid-Cookie-Name-1');
+    original.addCookie(cookie0);
+    assert_equals(fork.cookies.length, 1);
+    assert_equals(original.cookies.length, 3);
+
+    original.close();
+    fork.close();
+}, "forked cookie jars start from the same cookies");
@@ -0,0 +1,174 @@
+//! phantomjs: --cookies-file-format=journal
+
+var fs = require('fs');
+var cookiejar = require('cookiejar');
+
+function cookie(name) {
+    return {
+        'name':     name,
+        'value':    'Journaled-Value',
+        'domain':   'localhost',
+        'path':     '/',
+        'expires':  new Date().getTime() + 3600 * 1000 //< expires in 1h
+    };
+}
+
+test(function () {
+    var path = 'cookies-journal-1.dat';
+    this.add_cleanup(function () {
+        if (fs.exists(path)) {
+            fs.remove(path);
+        }
+    });
+
+    var jar = cookiejar.create(path);
+    jar.addCookie(cookie('First'));
+    jar.addCookie(cookie('Second'));
+    jar.flush();
+    var size = fs.size(path);
+
+    jar.deleteCookie('First');
+    jar.flush();
+    assert_greater_than(fs.size(path), size);
+    assert_equals(fs.read(path, 'b').substring(0, 4), 'PJCJ');
+
+    var reloaded = cookiejar.create(path);
+    assert_equals(reloaded.cookies.length, 1);
+    assert_equals(reloaded.cookies[0].name, 'Second');
+
+    jar.close();
+    reloaded.close();
+}, "cookie changes are appended to the journal and replayed on load");
+
+test(function () {
+    var path = 'cookies-journal-2.dat';
+    this.add_cleanup(function () {
+        if (fs.exists(path)) {
+            fs.remove(path);
+        }
+    });
+
+    var jar = cookiejar.create(path), i;
+    for (i = 0; i < 300; ++i) {
+        jar.addCookie(cookie('Churn'));
+        jar.flush();
+    }
+    assert_equals(jar.cookies.length, 1);
+    // 300 uncompacted records would take well over 10KB
+    assert_less_than(fs.size(path), 10000);
+
+    var reloaded = cookiejar.create(path);
+    assert_equals(reloaded.cookies.length, 1);
+    assert_equals(reloaded.cookies[0].name, 'Churn');
+
+    jar.close();
+    reloaded.close();
+}, "a journal full of overwritten cookies is compacted");
+
+test(function () {
+    var path = 'cookies-journal-3.dat';
+    this.add_cleanup(function () {
+        if (fs.exists(path)) {
+            fs.remove(path);
+        }
+    });
+
+    var jar1 = cookiejar.create(path);
+    var jar2 = cookiejar.create(path);
+
+    // Neither save overwrites the other one's cookies
+    jar1.addCookie(cookie('From-First-Jar'));
+    jar1.flush();
+    jar2.addCookie(cookie('From-Second-Jar'));
+    jar2.flush();
+
+    var reloaded = cookiejar.create(path);
+    assert_equals(reloaded.cookies.length, 2);
+    assert_equals(jar2.cookies.length, 2);
+
+    jar1.close();
+    jar2.close();
+    reloaded.close();
+}, "jars sharing a journal don't lose each other's writes");
+
+async_test(function () {
+    var path = 'cookies-journal-4.dat';
+    this.add_cleanup(function () {
+        if (fs.exists(path)) {
+            fs.remove(path);
+        }
+    });
+
+    var writer = cookiejar.create(path);
+    writer.addCookie(cookie('Existing'));
+    writer.flush();
+
+    var reader = cookiejar.create(path);
+    assert_equals(reader.cookies.length, 1);
+
+    writer.addCookie(cookie('Shared'));
+    writer.flush();
+
+    var test = this;
+    (function check() {
+        if (reader.cookies.length === 2) {
+            test.step(function () {
+                writer.close();
+                reader.close();
+            });
+            test.done();
+        } else {
+            setTimeout(test.step_func(check), 50);
+        }
+    }());
+}, "a jar sees changes written to its journal by another jar");
+
+test(function () {
+    var path = 'cookies-journal-5.dat';
+    this.add_cleanup(function () {
+        if (fs.exists(path)) {
+            fs.remove(path);
+        }
+    });
+
+    var session = cookie('Session');
+    delete session.expires;
+
+    var jar = cookiejar.create(path);
+    jar.addCookie(session);
+    jar.addCookie(cookie('Persistent'));
+    assert_equals(jar.cookies.length, 2);
+    jar.flush();
+    jar.close();
+
+    var reopened = cookiejar.create(path);
+    assert_equals(reopened.cookies.length, 1);
+    assert_equals(reopened.cookies[0].name, 'Persistent');
+    reopened.close();
+}, "session cookies are gone once the journal is reopened");
+
+test(function () {
+    var path = 'cookies-journal-6.dat';
+    this.add_cleanup(function () {
+        if (fs.exists(path)) {
+            fs.remove(path);
+        }
+    });
+
+    var session = cookie('Replaced');
+    delete session.expires;
+    session.value = 'Session-Value';
+
+    var jar = cookiejar.create(path);
+    jar.addCookie(cookie('Replaced'));
+    jar.flush();
+    jar.addCookie(session);
+    jar.flush();
+    assert_equals(jar.cookies.length, 1);
+    assert_equals(jar.cookies[0].value, 'Session-Value');
+    jar.close();
+
+    var reopened = cookiejar.create(path);
+    assert_equals(reopened.cookies.length, 0);
+    reopened.close();
+}, "a persistent cookie replaced by a session cookie is gone once the journal is reopened");
@@ -0,0 +1,71 @@
+var fs = require('fs');
+var cookiejar = require('cookiejar');
+
+var cookie = {
+    'name':     'Persistent-Cookie',
+    'value':    'Persistent-Value',
+    'domain':   'localhost',
+    'path':     '/',
+    'expires':  new Date().getTime() + 3600 * 1000 //< expires in 1h
+};
+
+test(function () {
+    var path = 'cookies-write-behind-1.txt';
+    this.add_cleanup(function () {
+        if (fs.exists(path)) {
+            fs.remove(path);
+        }
+    });
+
+    var jar = cookiejar.create(path);
+    assert_equals(jar.saveDelay, 500);
+
+    jar.addCookie(cookie);
+    jar.flush();
+
+    var reloaded = cookiejar.create(path);
+    assert_equals(reloaded.cookies.length, 1);
+    assert_equals(reloaded.cookies[0].name, 'Persistent-Cookie');
+
+    jar.close();
+    reloaded.close();
+}, "flush writes pending cookie changes to the cookies file");
+
+async_test(function () {
+    var path = 'cookies-write-behind-2.txt';
+    this.add_cleanup(function () {
+        if (fs.exists(path)) {
+            fs.remove(path);
+        }
+    });
+
+    var jar = cookiejar.create(path);
+    jar.saveDelay = 50;
+    jar.addCookie(cookie);
+
+    setTimeout(this.step_func_done(function () {
+        var reloaded = cookiejar.create(path);
+        assert_equals(reloaded.cookies.length, 1);
+        jar.close();
+        reloaded.close();
+    }), 500);
+}, "cookie changes are saved once the jar goes idle");
+
+test(function () {
+    var path = 'cookies-write-behind-3.txt';
+    this.add_cleanup(function () {
+        if (fs.exists(path)) {
+            fs.remove(path);
+        }
+    });
+
+    var jar = cookiejar.create(path);
+    jar.saveDelay = 0;
+    jar.addCookie(cookie);
+
+    var reloaded = cookiejar.create(path);
+    assert_equals(reloaded.cookies.length, 1);
+
+    jar.close();
+    reloaded.close();
+}, "a saveDelay of 0 writes every change through");
@@ -0,0 +1,97 @@
+// Binary Files API (readBytes, ...)
+
+var fs = require('fs');
+
+var FILENAME_BIN = "temp-binary.test";
+
+test(function () {
+    var data = String.fromCharCode(0, 1, 2, 127, 128, 255);
+    fs.write(FILENAME_BIN, data, "b");
+    this.add_cleanup(function () {
+        fs.remove(FILENAME_BIN);
+    });
+
+    var bytes = fs.readBytes(FILENAME_BIN);
+    assert_equals(bytes.length, 6);
+    assert_equals(bytes[0], 0);
+    assert_equals(bytes[3], 127);
+    assert_equals(bytes[4], 128);
+    assert_equals(bytes[5], 255);
+
+}, "read a binary file as bytes");
+
+test(function () {
+    fs.write(FILENAME_BIN, "0123456789", "b");
+    var f = fs.open(FILENAME_BIN, "rb");
+    this.add_cleanup(function () {
+        f.close();
+        fs.remove(FILENAME_BIN);
+    });
+
+    f.seek(2);
+    var bytes = f.readBytes(3);
+    assert_equals(bytes.length, 3);
+    assert_equals(String.fromCharCode(bytes[0], bytes[1], bytes[2]), "234");
+
+    // Reading the whole file doesn't depend on the current position
+    assert_equals(f.readBytes().length, 10);
+    assert_equals(f.readBytes(1)[0], "5".charCodeAt(0));
+
+}, "read some bytes from a binary file");
+
+test(function () {
+    fs.write(FILENAME_BIN, "", "b");
+    this.add_cleanup(function () {
+        fs.remove(FILENAME_BIN);
+    });
+
+    assert_equals(fs.readBytes(FILENAME_BIN).length, 0);
+
+}, "read an empty file as bytes");
+
+test(function () {
+    var bytes = new Uint8ClampedArray([0, 10, 128, 255]);
+    fs.writeBytes(FILENAME_BIN, bytes);
+    this.add_cleanup(function () {
+        fs.remove(FILENAME_BIN);
+    });
+
+    assert_equals(fs.size(FILENAME_BIN), 4);
+    assert_equals(fs.read(FILENAME_BIN, "b"), String.fromCharCode(0, 10, 128, 255));
+
+    // Bytes read from one file can be written to another as they are
+    fs.writeBytes(FILENAME_BIN, fs.readBytes(FILENAME_BIN), "a");
+    assert_equals(fs.size(FILENAME_BIN), 8);
+
+}, "write bytes to a binary file");
+
+test(function () {
+    var f = fs.open(FILENAME_BIN, "wb");
+    this.add_cleanup(function () {
+        f.close();
+        fs.remove(FILENAME_BIN);
+    });
+
+    assert_is_true(f.writeBatch(["ab", new Uint8ClampedArray([0, 255]), "cd"]));
+    f.close();
+
+    assert_equals(fs.read(FILENAME_BIN, "b"), "ab" + String.fromCharCode(0, 255) + "cd");
+
+}, "write a batch of chunks to a binary file");
+
+test(function () {
+    var f = fs.open(FILENAME_BIN, "w"), i, lines = [];
+    this.add_cleanup(function () {
+        f.close();
+        fs.remove(FILENAME_BIN);
+    });
+
+    for (i = 0; i < 1000; ++i) {
+        lines.push("line " + i + "\n");
+    }
+    assert_is_true(f.writeBatch(lines));
+    f.close();
+
+    assert_equals(fs.read(FILENAME_BIN), lines.join(""));
+
+}, "write a batch of lines to a text file");
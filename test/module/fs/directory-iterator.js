@@ -0,0 +1,58 @@
+// Directory iteration (openDirectory)
+
+var fs = require('fs');
+
+var TEST_DIR = "testdir-iterator";
+
+function makeTestDir(test) {
+    var i;
+    test.add_cleanup(function () { fs.removeTree(TEST_DIR); });
+    fs.makeTree(fs.join(TEST_DIR, "subdir"));
+    for (i = 0; i < 25; ++i) {
+        fs.write(fs.join(TEST_DIR, "shot" + i + ".png"), "12345");
+    }
+    fs.write(fs.join(TEST_DIR, "notes.txt"), "notes");
+}
+
+test(function () {
+    makeTestDir(this);
+    var dir = fs.openDirectory(TEST_DIR),
+        entries = [],
+        batch;
+    this.add_cleanup(function () { dir.close(); });
+
+    while ((batch = dir.next(10)).length > 0) {
+        assert_less_than_equal(batch.length, 10);
+        entries = entries.concat(batch);
+    }
+    assert_is_true(dir.atEnd());
+    assert_equals(entries.length, 27);
+
+    var subdir = entries.filter(function (e) { return e.name === "subdir"; })[0];
+    assert_is_true(subdir.isDirectory);
+    assert_is_false(subdir.isFile);
+
+    var notes = entries.filter(function (e) { return e.name === "notes.txt"; })[0];
+    assert_is_true(notes.isFile);
+    assert_equals(notes.size, 5);
+    assert_is_true(notes.lastModified instanceof Date);
+
+}, "walk the entries of a directory in batches");
+
+test(function () {
+    makeTestDir(this);
+    var dir = fs.openDirectory(TEST_DIR, { filter: "*.png", stat: false });
+    this.add_cleanup(function () { dir.close(); });
+
+    var entries = dir.next(100);
+    assert_equals(entries.length, 25);
+    assert_type_of(entries[0].size, "undefined");
+    assert_is_true(entries[0].isFile);
+
+}, "filter entries and leave out stat info");
+
+test(function () {
+    assert_throws("Unable to open directory 'absent-iterator'", function () {
+        fs.openDirectory("absent-iterator");
+    });
+}, "opening a missing directory throws");
@@ -0,0 +1,56 @@
+// Background directory tree operations (copyTreeAsync, removeTreeAsync)
+
+var fs = require('fs');
+
+var SOURCE = "testdir-tree-jobs",
+    DESTINATION = SOURCE + "-copy";
+
+function makeSourceTree() {
+    var i;
+    fs.makeTree(fs.join(SOURCE, "sub", "deeper"));
+    for (i = 0; i < 50; ++i) {
+        fs.write(fs.join(SOURCE, "file" + i + ".txt"), "content " + i);
+    }
+    fs.write(fs.join(SOURCE, "sub", "deeper", "nested.bin"), String.fromCharCode(0, 1, 2, 255), "b");
+}
+
+async_test(function () {
+    makeSourceTree();
+    this.add_cleanup(function () {
+        fs.removeTree(SOURCE);
+        fs.removeTree(DESTINATION);
+    });
+
+    var lastProgress = null;
+    fs.copyTreeAsync(SOURCE, DESTINATION, this.step_func_done(function (error) {
+        assert_equals(error, null);
+        assert_equals(lastProgress, "51/51");
+        assert_equals(fs.read(fs.join(DESTINATION, "file7.txt")), "content 7");
+        assert_equals(fs.read(fs.join(DESTINATION, "sub", "deeper", "nested.bin"), "b"),
+                      String.fromCharCode(0, 1, 2, 255));
+        assert_equals(fs.list(DESTINATION).length, fs.list(SOURCE).length);
+    }), function (done, total) {
+        lastProgress = done + "/" + total;
+    });
+
+}, "copy a directory tree in the background");
+
+async_test(function () {
+    var path = SOURCE + "-remove";
+    fs.makeTree(fs.join(path, "a", "b"));
+    fs.write(fs.join(path, "a", "b", "file.txt"), "content");
+    fs.write(fs.join(path, "top.txt"), "content");
+
+    fs.removeTreeAsync(path, this.step_func_done(function (error) {
+        assert_equals(error, null);
+        assert_is_false(fs.exists(path));
+    }));
+
+}, "remove a directory tree in the background");
+
+async_test(function () {
+    fs.copyTreeAsync("absent-tree-jobs", DESTINATION + "-absent", this.step_func_done(function (error) {
+        assert_equals(error, null);
+    }));
+
+}, "copying a missing tree does nothing, like copyTree");
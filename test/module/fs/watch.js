@@ -0,0 +1,44 @@
+// Watching files and directories (watch)
+
+var fs = require('fs');
+
+var SPOOL_DIR = "testdir-watch";
+
+async_test(function () {
+    fs.makeDirectory(SPOOL_DIR);
+    var watcher = fs.watch(SPOOL_DIR, this.step_func(function (event, path) {
+        assert_equals(event, "added");
+        assert_equals(path, fs.join(SPOOL_DIR, "job.txt"));
+        this.done();
+    }));
+    this.add_cleanup(function () {
+        watcher.close();
+        fs.removeTree(SPOOL_DIR);
+    });
+
+    fs.write(fs.join(SPOOL_DIR, "job.txt"), "work to do");
+
+}, "watching a directory reports new entries");
+
+async_test(function () {
+    var path = "temp-watch.test";
+    fs.write(path, "first");
+    var watcher = fs.watch(path, this.step_func(function (event, changedPath) {
+        assert_equals(event, "changed");
+        assert_equals(changedPath, path);
+        this.done();
+    }));
+    this.add_cleanup(function () {
+        watcher.close();
+        fs.remove(path);
+    });
+
+    fs.write(path, "second", "a");
+
+}, "watching a file reports changes");
+
+test(function () {
+    assert_throws("Unable to watch 'absent-watch'", function () {
+        fs.watch("absent-watch", function () {});
+    });
+}, "watching a missing path throws");
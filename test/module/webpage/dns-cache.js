@@ -0,0 +1,34 @@
+//! phantomjs: --dns-cache-ttl=60
+
+var webpage = require('webpage');
+
+test(function () {
+    assert_equals(phantom.hostResolverStats.entries, 0);
+}, "the DNS cache starts empty");
+
+async_test(function () {
+    var url = TEST_HTTP_BASE + 'hello.html';
+    var page = webpage.create();
+    var before = phantom.hostResolverStats;
+
+    page.open(url, this.step_func(function (status) {
+        assert_equals(status, 'success');
+        var afterFirst = phantom.hostResolverStats;
+        assert_greater_than(afterFirst.misses, before.misses);
+
+        var test = this;
+        (function reload() {
+            // The first lookup completes in the background
+            if (phantom.hostResolverStats.entries === 0) {
+                setTimeout(test.step_func(reload), 50);
+                return;
+            }
+            page.open(url, test.step_func_done(function (status) {
+                assert_equals(status, 'success');
+                assert_equals(page.url, url);
+                assert_greater_than(phantom.hostResolverStats.hits, afterFirst.hits);
+            }));
+        }());
+    }));
+
+}, "a host is looked up once, then served from the DNS cache");
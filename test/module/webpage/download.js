@@ -0,0 +1,38 @@
+var webpage = require('webpage');
+var fs = require('fs');
+
+var DOWNLOAD_DIR = "temp-download-dir";
+
+test(function () {
+    var page = webpage.create();
+    assert_equals(page.downloadDirectory, "");
+    page.downloadDirectory = DOWNLOAD_DIR;
+    assert_equals(page.downloadDirectory, DOWNLOAD_DIR);
+}, "page.downloadDirectory");
+
+async_test(function () {
+    var page = webpage.create();
+    var size = 300 * 1024;
+    var started = null;
+
+    page.downloadDirectory = DOWNLOAD_DIR;
+    this.add_cleanup(function () { fs.removeTree(DOWNLOAD_DIR); });
+
+    page.onDownloadStarted = this.step_func(function (download) {
+        started = download;
+        assert_equals(download.url, TEST_HTTP_BASE + "download?size=" + size);
+        assert_equals(download.bytesTotal, size);
+    });
+
+    page.onDownloadFinished = this.step_func_done(function (download) {
+        assert_not_equals(started, null);
+        assert_equals(download.id, started.id);
+        assert_equals(download.status, "success");
+        assert_equals(download.bytesReceived, size);
+        assert_equals(fs.absolute(download.fileName), fs.absolute(DOWNLOAD_DIR + "/export.csv"));
+        assert_equals(fs.size(download.fileName), size);
+    });
+
+    page.open(TEST_HTTP_BASE + "download?size=" + size);
+
+}, "stream unsupported content to page.downloadDirectory");
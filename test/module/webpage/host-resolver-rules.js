@@ -0,0 +1,26 @@
+var webpage = require('webpage');
+
+test(function () {
+    assert_type_of(phantom.hostResolverRules, 'string');
+    assert_type_of(phantom.hostResolverStats, 'object');
+    assert_type_of(phantom.hostResolverStats.lookups, 'number');
+    assert_type_of(phantom.hostResolverStats.hitRate, 'number');
+}, "phantom.hostResolverRules and phantom.hostResolverStats");
+
+async_test(function () {
+    var authority = TEST_HTTP_BASE.replace(/^http:\/\//, '').replace(/\/$/, '');
+    var mappedBase = 'http://mapped-host.invalid/';
+    var page = webpage.create();
+
+    phantom.hostResolverRules = 'MAP mapped-host.invalid ' + authority;
+    this.add_cleanup(function () { phantom.hostResolverRules = ''; });
+    var mappedBefore = phantom.hostResolverStats.mapped;
+
+    page.open(mappedBase + 'hello.html', this.step_func_done(function (status) {
+        assert_equals(status, 'success');
+        assert_equals(page.url, mappedBase + 'hello.html');
+        assert_equals(page.title, 'Hello');
+        assert_greater_than(phantom.hostResolverStats.mapped, mappedBefore);
+    }));
+
+}, "load a page from a host mapped with host resolver rules");
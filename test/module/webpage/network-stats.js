@@ -0,0 +1,35 @@
+var webpage = require('webpage');
+
+test(function () {
+    var page = webpage.create();
+    var stats = page.networkStats;
+    assert_type_of(stats, 'object');
+    assert_equals(stats.requests, 0);
+    assert_equals(stats.finished, 0);
+    assert_equals(stats.pending, 0);
+    assert_equals(stats.bytesReceived, 0);
+}, "page.networkStats starts at zero");
+
+async_test(function () {
+    var page = webpage.create();
+
+    page.open(TEST_HTTP_BASE + 'logo.html', this.step_func(function (status) {
+        assert_equals(status, 'success');
+
+        var stats = page.networkStats;
+        assert_equals(stats.requests, 2);
+        assert_equals(stats.finished, 2);
+        assert_equals(stats.pending, 0);
+        assert_equals(stats.errors, 0);
+        assert_greater_than(stats.bytesReceived, 0);
+
+        page.resetNetworkStats();
+        assert_equals(page.networkStats.requests, 0);
+
+        page.open(TEST_HTTP_BASE + 'missing-img.html', this.step_func_done(function () {
+            assert_equals(page.networkStats.requests, 2);
+            assert_equals(page.networkStats.errors, 1);
+        }));
+    }));
+
+}, "page.networkStats counts requests, bytes and errors");
@@ -44,3 +44,24 @@ async_test(function () {
 
 
 }, "POST data is available in onResourceRequested");
+
+async_test(function () {
+
+    var postdata = new Array(100 * 1024 + 1).join("a");
+    var pageOptions = {
+        onResourceRequested: this.step_func(function (request, networkRequest) {
+            assert_equals(request.postDataSize, postdata.length);
+            assert_no_property(request, "postData");
+            assert_equals(networkRequest.postDataSize, postdata.length);
+            assert_equals(networkRequest.postData(), postdata);
+        }),
+        onLoadFinished: this.step_func_done(function (status) {
+            validate_echo_response(status, page, postdata);
+        })
+    };
+
+    var page = new WebPage(pageOptions);
+    page.open(TEST_HTTP_BASE + "echo", 'post', postdata);
+
+
+}, "large POST data is only available on demand in onResourceRequested");
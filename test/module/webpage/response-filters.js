@@ -0,0 +1,45 @@
+var webpage = require('webpage');
+
+test(function () {
+    var page = webpage.create();
+    assert_type_of(page.responseFilters, 'object');
+    assert_equals(page.responseFilters.length, 0);
+
+    page.responseFilters = [
+        { type: 'replace', search: 'Hello', replace: 'Howdy' },
+        { type: 'replace' },
+        { type: 'unknown', name: 'X-Header' }
+    ];
+    assert_equals(page.responseFilters.length, 1);
+    assert_equals(page.responseFilters[0].search, 'Hello');
+}, "invalid response filters are ignored");
+
+async_test(function () {
+    var page = webpage.create();
+    var headers = {};
+
+    page.responseFilters = [
+        { url: 'hello\\.html$', type: 'replace', search: 'Hello', replace: 'Howdy' },
+        { url: 'hello\\.html$', type: 'replaceRegExp', search: '(world)!', replace: 'big \\1.' },
+        { url: 'hello\\.html$', type: 'setHeader', name: 'X-Filtered', value: 'yes' },
+        { url: 'hello\\.html$', type: 'removeHeader', name: 'Content-Length' },
+        { url: 'other\\.html$', type: 'replace', search: 'Howdy', replace: 'Bye' }
+    ];
+
+    page.onResourceReceived = this.step_func(function (response) {
+        if (response.stage === 'end') {
+            response.headers.forEach(function (header) {
+                headers[header.name.toLowerCase()] = header.value;
+            });
+        }
+    });
+
+    page.open(TEST_HTTP_BASE + 'hello.html', this.step_func_done(function (status) {
+        assert_equals(status, 'success');
+        assert_equals(page.title, 'Howdy');
+        assert_equals(page.plainText, 'Howdy, big world.');
+        assert_equals(headers['x-filtered'], 'yes');
+        assert_is_false('content-length' in headers);
+    }));
+
+}, "rewrite a response with page.responseFilters");
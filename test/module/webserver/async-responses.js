@@ -0,0 +1,42 @@
+var server, port;
+setup(function () {
+    server = require("webserver").create();
+    for (var i = 1024; i < 32768; i++) {
+        if (server.listen(i, function (rq, rs) { return request_cb(rq, rs); })) {
+            port = server.port;
+            return;
+        }
+    }
+    assert_unreached("unable to find a free TCP port for server tests");
+});
+
+var request_cb;
+
+async_test(function () {
+    // More requests in flight than mongoose worker threads (10 by default):
+    // none of them is answered before all of them have arrived.
+    var count = 12, pending = [], loaded = 0;
+    var webpage = require("webpage");
+
+    request_cb = this.step_func(function (request, response) {
+        pending.push(response);
+        if (pending.length === count) {
+            pending.forEach(function (rs) {
+                rs.write("async");
+                rs.close();
+            });
+        }
+    });
+
+    for (var i = 0; i < count; i++) {
+        var page = webpage.create();
+        page.open("http://localhost:" + port + "/async/" + i,
+                  this.step_func(function (status) {
+            assert_equals(status, "success");
+            if (++loaded === count) {
+                this.done();
+            }
+        }));
+    }
+
+}, "responses are not bound to mongoose worker threads", { "test_timeout": 10000 });
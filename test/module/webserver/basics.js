@@ -23,3 +23,12 @@ test(function () {
     assert_type_of(server.close, "function");
 
 }, "WebServer object properties");
+
+test(function () {
+    var server = require("webserver").create();
+
+    assert_is_false(server.listen(8080, { numThreads: 0 }, function () {}));
+    assert_is_false(server.listen(8080, { backlog: "many" }, function () {}));
+    assert_equals(server.port, "");
+
+}, "WebServer rejects invalid listen() tuning options");
@@ -0,0 +1,86 @@
+var fs = require("fs");
+var server, port, request_cb;
+setup(function () {
+    server = require("webserver").create();
+    for (var i = 1024; i < 32768; i++) {
+        if (server.listen(i, function (rq, rs) { return request_cb(rq, rs); })) {
+            port = server.port;
+            return;
+        }
+    }
+    assert_unreached("unable to find a free TCP port for server tests");
+});
+
+async_test(function () {
+    var page = require("webpage").create();
+
+    request_cb = this.step_func(function (request, response) {
+        response.setHeader("Content-Type", "text/plain; charset=utf-8");
+        // UTF-8 encoded "héllo": must reach the client without being re-encoded
+        response.writeBase64("aMOpbGxv");
+        response.close();
+    });
+
+    page.open("http://localhost:" + port + "/base64",
+              this.step_func_done(function (status) {
+        assert_equals(status, "success");
+        assert_equals(page.plainText, "héllo");
+    }));
+
+}, "writeBase64() sends the decoded bytes unchanged");
+
+async_test(function () {
+    var page = require("webpage").create();
+    var path = fs.join(fs.workingDirectory, "webserver-writefile.txt");
+    fs.write(path, "served from disk", "w");
+
+    request_cb = this.step_func(function (request, response) {
+        response.setHeader("Content-Type", "text/plain");
+        assert_is_true(response.writeFile(path));
+        response.close();
+    });
+
+    page.open("http://localhost:" + port + "/file",
+              this.step_func_done(function (status) {
+        fs.remove(path);
+        assert_equals(status, "success");
+        assert_equals(page.plainText, "served from disk");
+    }));
+
+}, "writeFile() sends the contents of a file");
+
+async_test(function () {
+    var page = require("webpage").create();
+
+    request_cb = this.step_func(function (request, response) {
+        assert_is_false(response.writeFile("/no/such/file/for/phantomjs"));
+        response.statusCode = 404;
+        response.write("missing");
+        response.close();
+    });
+
+    page.open("http://localhost:" + port + "/missing",
+              this.step_func_done(function (status) {
+        assert_equals(page.plainText, "missing");
+    }));
+
+}, "writeFile() returns false for unreadable files");
+
+async_test(function () {
+    var page = require("webpage").create();
+
+    request_cb = this.step_func(function (request, response) {
+        response.setEncoding("ISO-8859-1");
+        response.setHeader("Content-Type", "text/plain; charset=iso-8859-1");
+        response.write("café ");
+        response.write("crème");
+        response.close();
+    });
+
+    page.open("http://localhost:" + port + "/latin1",
+              this.step_func_done(function (status) {
+        assert_equals(status, "success");
+        assert_equals(page.plainText, "café crème");
+    }));
+
+}, "setEncoding() applies to every subsequent write()");
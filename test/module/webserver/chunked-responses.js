@@ -0,0 +1,78 @@
+var server, port, request_cb;
+setup(function () {
+    server = require("webserver").create();
+    for (var i = 1024; i < 32768; i++) {
+        if (server.listen(i, { keepAlive: true },
+                          function (rq, rs) { return request_cb(rq, rs); })) {
+            port = server.port;
+            return;
+        }
+    }
+    assert_unreached("unable to find a free TCP port for server tests");
+});
+
+function headerValue(headers, name) {
+    for (var i = 0; i < headers.length; i++) {
+        if (headers[i].name.toLowerCase() === name.toLowerCase()) {
+            return headers[i].value;
+        }
+    }
+    return null;
+}
+
+async_test(function () {
+    var page = require("webpage").create();
+    var transferEncoding;
+
+    request_cb = this.step_func(function (request, response) {
+        response.setHeader("Content-Type", "application/x-ndjson");
+        var row = 0;
+        var timer = setInterval(function () {
+            response.write(JSON.stringify({ row: row }) + "\n");
+            if (++row === 3) {
+                clearInterval(timer);
+                response.close();
+            }
+        }, 10);
+    });
+
+    page.onResourceReceived = this.step_func(function (resp) {
+        if (resp.stage === "start") {
+            transferEncoding = headerValue(resp.headers, "Transfer-Encoding");
+        }
+    });
+
+    page.open("http://localhost:" + port + "/rows",
+              this.step_func_done(function (status) {
+        assert_equals(status, "success");
+        assert_equals(transferEncoding, "chunked");
+        assert_equals(page.plainText, '{"row":0}\n{"row":1}\n{"row":2}');
+    }));
+
+}, "responses without Content-Length are streamed in chunks");
+
+async_test(function () {
+    var page = require("webpage").create();
+    var transferEncoding;
+
+    request_cb = this.step_func(function (request, response) {
+        response.writeHead(200, { "Content-Type": "text/plain",
+                                  "content-length": "5" });
+        response.write("fixed");
+        response.close();
+    });
+
+    page.onResourceReceived = this.step_func(function (resp) {
+        if (resp.stage === "start") {
+            transferEncoding = headerValue(resp.headers, "Transfer-Encoding");
+        }
+    });
+
+    page.open("http://localhost:" + port + "/fixed",
+              this.step_func_done(function (status) {
+        assert_equals(status, "success");
+        assert_equals(transferEncoding, null);
+        assert_equals(page.plainText, "fixed");
+    }));
+
+}, "responses with a Content-Length are not chunked");
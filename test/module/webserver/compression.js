@@ -0,0 +1,82 @@
+var server, port, request_cb;
+setup(function () {
+    server = require("webserver").create();
+    assert_is_false(server.listen(1024, { compressionLevel: 10 }, function () {}));
+    for (var i = 1024; i < 32768; i++) {
+        if (server.listen(i, { compressionLevel: 6, compressionMinSize: 256 },
+                          function (rq, rs) { return request_cb(rq, rs); })) {
+            port = server.port;
+            return;
+        }
+    }
+    assert_unreached("unable to find a free TCP port for server tests");
+});
+
+function arm_responder(test, contentType, body) {
+    request_cb = test.step_func(function (request, response) {
+        response.setHeader("Content-Type", contentType);
+        // written in pieces, to exercise the streaming compressor
+        for (var i = 0; i < body.length; i += 100) {
+            response.write(body.substr(i, 100));
+        }
+        response.close();
+    });
+}
+
+function contentEncoding(page, test) {
+    var result = { value: undefined };
+    page.onResourceReceived = test.step_func(function (resp) {
+        if (resp.stage !== "start") {
+            return;
+        }
+        result.value = null;
+        resp.headers.forEach(function (hdr) {
+            if (hdr.name.toLowerCase() === "content-encoding") {
+                result.value = hdr.value;
+            }
+        });
+    });
+    return result;
+}
+
+var longText = new Array(200).join("All work and no play makes Jack a dull boy. ") + "The end.";
+
+async_test(function () {
+    var page = require("webpage").create();
+    var encoding = contentEncoding(page, this);
+    arm_responder(this, "text/plain", longText);
+
+    page.open("http://localhost:" + port + "/long",
+              this.step_func_done(function (status) {
+        assert_equals(status, "success");
+        assert_equals(encoding.value, "gzip");
+        assert_equals(page.plainText, longText);
+    }));
+
+}, "large text responses are compressed");
+
+async_test(function () {
+    var page = require("webpage").create();
+    var encoding = contentEncoding(page, this);
+    arm_responder(this, "text/plain", "short and sweet");
+
+    page.open("http://localhost:" + port + "/short",
+              this.step_func_done(function (status) {
+        assert_equals(status, "success");
+        assert_equals(encoding.value, null);
+        assert_equals(page.plainText, "short and sweet");
+    }));
+
+}, "responses below compressionMinSize are sent as they are");
+
+async_test(function () {
+    var page = require("webpage").create();
+    var encoding = contentEncoding(page, this);
+    arm_responder(this, "application/octet-stream", longText);
+
+    page.open("http://localhost:" + port + "/binary",
+              this.step_func_done(function (status) {
+        assert_equals(encoding.value, null);
+    }));
+
+}, "only text-like content types are compressed");
@@ -0,0 +1,65 @@
+var server, port, request_cb;
+setup(function () {
+    server = require("webserver").create();
+    var options = {
+        livenessPath: "/healthz",
+        readinessPath: "/readyz",
+        metricsPath: "/metrics"
+    };
+    for (var i = 1024; i < 32768; i++) {
+        if (server.listen(i, options, function (rq, rs) { return request_cb(rq, rs); })) {
+            port = server.port;
+            return;
+        }
+    }
+    assert_unreached("unable to find a free TCP port for server tests");
+});
+
+function url(path) {
+    return "http://localhost:" + port + path;
+}
+
+async_test(function () {
+    var page = require("webpage").create();
+    request_cb = this.unreached_func("native routes must not reach the request handler");
+
+    page.open(url("/healthz"), this.step_func(function (status) {
+        assert_equals(status, "success");
+        assert_regexp_match(page.plainText, /^ok\s*$/);
+
+        page.open(url("/readyz"), this.step_func_done(function (status) {
+            assert_equals(status, "success");
+            assert_regexp_match(page.plainText, /^ready\s*$/);
+        }));
+    }));
+
+}, "liveness and readiness are answered natively");
+
+async_test(function () {
+    var page = require("webpage").create();
+    request_cb = this.unreached_func("native routes must not reach the request handler");
+
+    page.open(url("/metrics"), this.step_func_done(function (status) {
+        assert_equals(status, "success");
+        var text = page.plainText;
+        assert_regexp_match(text, /^phantomjs_web_pages [0-9]+$/m);
+        assert_regexp_match(text, /^phantomjs_webserver_pending_responses 0$/m);
+        assert_regexp_match(text, /^phantomjs_event_loop_lag_seconds [0-9.e-]+$/m);
+        assert_regexp_match(text, /^# TYPE phantomjs_web_pages gauge$/m);
+    }));
+
+}, "metrics are reported in the Prometheus text format");
+
+async_test(function () {
+    var page = require("webpage").create();
+    request_cb = this.step_func(function (request, response) {
+        assert_equals(request.url, "/healthz/deeper");
+        response.write("script");
+        response.close();
+    });
+
+    page.open(url("/healthz/deeper"), this.step_func_done(function (status) {
+        assert_equals(page.plainText, "script");
+    }));
+
+}, "other paths still reach the request handler");
@@ -0,0 +1,106 @@
+var server, port, request_cb;
+setup(function () {
+    server = require("webserver").create();
+    for (var i = 1024; i < 32768; i++) {
+        if (server.listen(i, function (rq, rs) { return request_cb(rq, rs); })) {
+            port = server.port;
+            return;
+        }
+    }
+    assert_unreached("unable to find a free TCP port for server tests");
+});
+
+function servePage(response, script) {
+    response.setHeader("Content-Type", "text/html");
+    response.write("<html><body><script>" + script + "</script></body></html>");
+    response.close();
+}
+
+async_test(function () {
+    var page = require("webpage").create();
+    var received = [];
+
+    request_cb = this.step_func(function (request, response) {
+        if (request.url === "/") {
+            servePage(response,
+                "var source = new EventSource('/events');" +
+                "source.addEventListener('tick', function (e) {" +
+                "    window.callPhantom({ data: e.data, id: e.lastEventId });" +
+                "});");
+            return;
+        }
+        assert_equals(request.url, "/events");
+        assert_is_true(response.startEventStream());
+        response.sendEvent("first", { event: "tick", id: "1" });
+        response.sendEvent("second\nline", { event: "tick", id: "2" });
+        response.onClose = function () {
+            response.close();
+        };
+    });
+
+    page.onCallback = this.step_func(function (event) {
+        received.push(event);
+        if (received.length === 2) {
+            assert_deep_equals(received, [
+                { data: "first", id: "1" },
+                { data: "second\nline", id: "2" }
+            ]);
+            page.close();
+            this.done();
+        }
+    });
+
+    page.open("http://localhost:" + port + "/");
+
+}, "server-sent events are pushed to an EventSource");
+
+async_test(function () {
+    var page = require("webpage").create();
+
+    request_cb = this.step_func(function (request, response) {
+        if (request.url === "/") {
+            servePage(response,
+                "var ws = new WebSocket('ws://localhost:" + port + "/socket', 'chat');" +
+                "ws.onopen = function () { ws.send('hello'); };" +
+                "ws.onmessage = function (e) {" +
+                "    window.callPhantom({ data: e.data, protocol: ws.protocol });" +
+                "};");
+            return;
+        }
+        assert_equals(request.url, "/socket");
+        assert_equals(request.headers["Upgrade"].toLowerCase(), "websocket");
+        assert_is_true(response.acceptWebSocket("chat"));
+        response.onMessage = function (message) {
+            response.sendMessage("echo: " + message);
+        };
+        response.onClose = function () {
+            response.close();
+        };
+    });
+
+    page.onCallback = this.step_func_done(function (event) {
+        assert_equals(event.data, "echo: hello");
+        assert_equals(event.protocol, "chat");
+        page.close();
+    });
+
+    page.open("http://localhost:" + port + "/");
+
+}, "WebSocket messages are exchanged in both directions");
+
+async_test(function () {
+    var page = require("webpage").create();
+
+    request_cb = this.step_func(function (request, response) {
+        assert_is_false(response.acceptWebSocket());
+        response.statusCode = 400;
+        response.write("not a websocket");
+        response.close();
+    });
+
+    page.open("http://localhost:" + port + "/plain",
+              this.step_func_done(function (status) {
+        assert_equals(page.plainText, "not a websocket");
+    }));
+
+}, "acceptWebSocket() refuses plain requests");
@@ -0,0 +1,57 @@
+var fs = require("fs");
+var server, port, request_cb;
+setup(function () {
+    server = require("webserver").create();
+    for (var i = 1024; i < 32768; i++) {
+        if (server.listen(i, { maxInlineBodySize: 16 },
+                          function (rq, rs) { return request_cb(rq, rs); })) {
+            port = server.port;
+            return;
+        }
+    }
+    assert_unreached("unable to find a free TCP port for server tests");
+});
+
+async_test(function () {
+    var page = require("webpage").create();
+    var body = "universe=expanding&answer=42";
+    var postFile;
+
+    request_cb = this.step_func(function (request, response) {
+        assert_no_property(request, "post");
+        assert_equals(request.postSize, body.length);
+        postFile = request.postFile;
+        assert_is_true(fs.isFile(postFile));
+        assert_equals(fs.read(postFile), body);
+
+        response.write("spooled");
+        response.close();
+    });
+
+    page.open("http://localhost:" + port + "/upload", "post", body,
+              this.step_func_done(function (status) {
+        assert_equals(status, "success");
+        assert_equals(page.plainText, "spooled");
+        // The temporary file goes away with the response
+        assert_is_false(fs.exists(postFile));
+    }));
+
+}, "request bodies larger than maxInlineBodySize are spooled to request.postFile");
+
+async_test(function () {
+    var page = require("webpage").create();
+
+    request_cb = this.step_func(function (request, response) {
+        assert_equals(request.post, "small");
+        assert_no_property(request, "postFile");
+        response.write("inline");
+        response.close();
+    });
+
+    page.open("http://localhost:" + port + "/upload", "post", "small",
+              this.step_func_done(function (status) {
+        assert_equals(status, "success");
+        assert_equals(page.plainText, "inline");
+    }));
+
+}, "small request bodies are still available as request.post");
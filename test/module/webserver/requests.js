@@ -173,3 +173,30 @@ async_test(function () {
                           // https://github.com/ariya/phantomjs/issues/13026
                           // and perhaps others
 });
+
+async_test(function () {
+    var page = require("webpage").create();
+    var url = "http://localhost:"+port+"/headers?a=b";
+
+    request_cb = this.step_func(function (request, response) {
+        try {
+            assert_equals(request.url, "/headers?a=b");
+            assert_type_of(request.header, "function");
+            assert_equals(request.header("x-custom-header"), "Value");
+            assert_equals(request.header("X-CUSTOM-HEADER"), "Value");
+            assert_equals(request.header("x-missing"), undefined);
+            // not enumerable: the request still serializes as before
+            assert_equals(Object.keys(request).indexOf("header"), -1);
+            response.write("request handled");
+        } finally {
+            response.close();
+            request_cb = this.unreached_func();
+        }
+    });
+
+    page.customHeaders = { "X-Custom-Header": "Value" };
+    page.open(url, "get", this.step_func_done(function (status) {
+        assert_equals(status, "success");
+    }));
+
+}, "case-insensitive lookup of request headers");
@@ -0,0 +1,101 @@
+var fs = require("fs");
+var server, port, request_cb, root;
+setup(function () {
+    root = fs.join(fs.workingDirectory, "webserver-static-root");
+    fs.makeTree(fs.join(root, "sub"));
+    fs.write(fs.join(root, "hello.txt"), "0123456789abcdef", "w");
+    fs.write(fs.join(root, "sub", "index.html"),
+             "<html><body>index</body></html>", "w");
+
+    server = require("webserver").create();
+    assert_is_false(server.mount("/nope", fs.join(root, "does-not-exist")));
+    assert_is_true(server.mount("/static/", root));
+
+    for (var i = 1024; i < 32768; i++) {
+        if (server.listen(i, function (rq, rs) { return request_cb(rq, rs); })) {
+            port = server.port;
+            return;
+        }
+    }
+    assert_unreached("unable to find a free TCP port for server tests");
+});
+
+function staticUrl(path) {
+    return "http://localhost:" + port + "/static" + path;
+}
+
+async_test(function () {
+    var page = require("webpage").create();
+    request_cb = this.unreached_func("static files must not reach the request handler");
+
+    page.open(staticUrl("/hello.txt"), this.step_func(function (status) {
+        assert_equals(status, "success");
+        assert_equals(page.plainText, "0123456789abcdef");
+
+        var result = page.evaluate(function () {
+            function get(headers) {
+                var xhr = new XMLHttpRequest();
+                xhr.open("GET", "/static/hello.txt", false);
+                for (var name in headers) {
+                    xhr.setRequestHeader(name, headers[name]);
+                }
+                xhr.send();
+                return xhr;
+            }
+            var full = get({});
+            var etag = full.getResponseHeader("ETag");
+            var range = get({ "Range": "bytes=10-12" });
+            var suffix = get({ "Range": "bytes=-4" });
+            var cached = get({ "If-None-Match": etag });
+            return {
+                etag: etag,
+                lastModified: full.getResponseHeader("Last-Modified"),
+                rangeStatus: range.status,
+                rangeText: range.responseText,
+                contentRange: range.getResponseHeader("Content-Range"),
+                suffixText: suffix.responseText,
+                cachedStatus: cached.status
+            };
+        });
+
+        assert_not_equals(result.etag, null);
+        assert_not_equals(result.lastModified, null);
+        assert_equals(result.rangeStatus, 206);
+        assert_equals(result.rangeText, "abc");
+        assert_equals(result.contentRange, "bytes 10-12/16");
+        assert_equals(result.suffixText, "cdef");
+        assert_equals(result.cachedStatus, 304);
+        this.done();
+    }));
+
+}, "mounted files are served natively, with ranges and validators");
+
+async_test(function () {
+    var page = require("webpage").create();
+    request_cb = this.unreached_func("static files must not reach the request handler");
+
+    page.open(staticUrl("/sub"), this.step_func_done(function (status) {
+        assert_equals(status, "success");
+        assert_equals(page.url, staticUrl("/sub/"));
+        assert_equals(page.plainText, "index");
+    }));
+
+}, "mounted directories redirect to their index file");
+
+async_test(function () {
+    var page = require("webpage").create();
+    request_cb = this.step_func(function (request, response) {
+        assert_equals(request.url, "/elsewhere");
+        response.write("dynamic");
+        response.close();
+    });
+
+    page.open("http://localhost:" + port + "/elsewhere",
+              this.step_func_done(function (status) {
+        assert_equals(page.plainText, "dynamic");
+        assert_is_true(server.unmount("/static"));
+        assert_is_false(server.unmount("/static"));
+        fs.removeTree(root);
+    }));
+
+}, "requests outside of the mounts still reach the request handler");
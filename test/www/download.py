@@ -0,0 +1,17 @@
+import urlparse
+import cStringIO as StringIO
+
+def handle_request(req):
+    url = urlparse.urlparse(req.path)
+    query = dict(urlparse.parse_qsl(url.query))
+    size = int(query.get('size', '1024'))
+
+    line = "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcde\n"
+    body = (line * (size // len(line) + 1))[:size]
+
+    req.send_response(200)
+    req.send_header('Content-Type', 'application/octet-stream')
+    req.send_header('Content-Disposition', 'attachment; filename="export.csv"')
+    req.send_header('Content-Length', str(len(body)))
+    req.end_headers()
+    return StringIO.StringIO(body)
@@ -0,0 +1,184 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+#
+#  This file is part of the PhantomJS project from Ofi Labs.
+#
+#  Redistribution and use in source and binary forms, with or without
+#  modification, are permitted provided that the following conditions are met:
+#
+#    * Redistributions of source code must retain the above copyright
+#      notice, this list of conditions and the following disclaimer.
+#    * Redistributions in binary form must reproduce the above copyright
+#      notice, this list of conditions and the following disclaimer in the
+#      documentation and/or other materials provided with the distribution.
+#    * Neither the name of the <organization> nor the
+#      names of its contributors may be used to endorse or promote products
+#      derived from this software without specific prior written permission.
+#
+#  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+#  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+#  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+#  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+#  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+#  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+#  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+#  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+#  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+#  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+# Load benchmark for the scriptable web server (see examples/serverbench.js).
+#
+# Starts phantomjs once per configuration, hammers it with a built-in
+# HTTP load generator (no external tool needed), and prints requests per
+# second and latency percentiles, e.g.:
+#
+#   tools/webserver-bench.py --delay 50 --concurrency 50 \
+#       --config "numThreads=10" --config "numThreads=50" \
+#       --config "numThreads=50 keepAlive=true keepAliveTimeout=1000"
+
+from __future__ import print_function
+
+import argparse
+import os
+import socket
+import subprocess
+import sys
+import threading
+import time
+
+root = os.path.abspath(os.path.join(os.path.dirname(__file__), ".."))
+
+
+def free_port():
+    s = socket.socket()
+    s.bind(("127.0.0.1", 0))
+    port = s.getsockname()[1]
+    s.close()
+    return port
+
+
+def start_server(phantomjs, port, delay, options):
+    script = os.path.join(root, "examples", "serverbench.js")
+    proc = subprocess.Popen([phantomjs, script, str(port), str(delay)] + options,
+                            stdout=subprocess.PIPE, universal_newlines=True)
+    line = proc.stdout.readline()
+    if "running" not in line:
+        proc.kill()
+        raise RuntimeError("server did not start: " + line.strip())
+    return proc
+
+
+def send_request(sock, port, keep_alive):
+    request = "GET /bench HTTP/1.1\r\nHost: 127.0.0.1:%d\r\nConnection: %s\r\n\r\n" % (
+        port, "keep-alive" if keep_alive else "close")
+    sock.sendall(request.encode("ascii"))
+    data = b""
+    while b"\r\n\r\n" not in data:
+        chunk = sock.recv(4096)
+        if not chunk:
+            raise IOError("connection closed")
+        data += chunk
+    head, body = data.split(b"\r\n\r\n", 1)
+    length = None
+    for line in head.split(b"\r\n")[1:]:
+        name, _, value = line.partition(b":")
+        if name.strip().lower() == b"content-length":
+            length = int(value)
+    while length is not None and len(body) < length:
+        chunk = sock.recv(4096)
+        if not chunk:
+            break
+        body += chunk
+    if not head.startswith(b"HTTP/1.1 200"):
+        raise IOError(head.split(b"\r\n")[0])
+
+
+def worker(port, count, keep_alive, latencies, errors, lock):
+    sock = None
+    for _ in range(count):
+        start = time.time()
+        try:
+            if sock is None:
+                sock = socket.create_connection(("127.0.0.1", port))
+            send_request(sock, port, keep_alive)
+            if not keep_alive:
+                sock.close()
+                sock = None
+            elapsed = time.time() - start
+            with lock:
+                latencies.append(elapsed)
+        except (IOError, socket.error):
+            with lock:
+                errors[0] += 1
+            if sock is not None:
+                sock.close()
+                sock = None
+    if sock is not None:
+        sock.close()
+
+
+def percentile(values, p):
+    if not values:
+        return float("nan")
+    values = sorted(values)
+    index = min(len(values) - 1, int(round(p / 100.0 * (len(values) - 1))))
+    return values[index]
+
+
+def run(args, config):
+    options = config.split()
+    keep_alive = "keepAlive=true" in options
+    port = free_port()
+    proc = start_server(args.phantomjs, port, args.delay, options)
+    try:
+        latencies, errors, lock = [], [0], threading.Lock()
+        per_worker = max(1, args.requests // args.concurrency)
+        threads = [threading.Thread(target=worker,
+                                    args=(port, per_worker, keep_alive, latencies, errors, lock))
+                   for _ in range(args.concurrency)]
+        start = time.time()
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        elapsed = time.time() - start
+    finally:
+        proc.kill()
+        proc.wait()
+
+    print("%-50s %8.1f %9.1f %9.1f %7d" % (
+        config or "(defaults)",
+        len(latencies) / elapsed,
+        percentile(latencies, 50) * 1000,
+        percentile(latencies, 99) * 1000,
+        errors[0]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Load benchmark for the PhantomJS web server")
+    parser.add_argument("--phantomjs", default=os.path.join(root, "bin", "phantomjs"),
+                        help="phantomjs binary (default: bin/phantomjs)")
+    parser.add_argument("--requests", type=int, default=2000,
+                        help="total number of requests per configuration")
+    parser.add_argument("--concurrency", type=int, default=20,
+                        help="number of concurrent clients")
+    parser.add_argument("--delay", type=int, default=0,
+                        help="ms the script waits before answering, standing for a render")
+    parser.add_argument("--config", action="append",
+                        help="listen() options, e.g. \"numThreads=20 keepAlive=true\" (repeatable)")
+    args = parser.parse_args()
+
+    configs = args.config or ["", "numThreads=4", "numThreads=32",
+                              "numThreads=32 backlog=256",
+                              "numThreads=32 keepAlive=true keepAliveTimeout=2000"]
+
+    print("%d requests, %d clients, %d ms delay" % (args.requests, args.concurrency, args.delay))
+    print("%-50s %8s %9s %9s %7s" % ("configuration", "req/s", "p50 (ms)", "p99 (ms)", "errors"))
+    for config in configs:
+        run(args, config)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())